@@ -5,6 +5,7 @@
 
 #include "util/sparse_table.h"
 #include "util/ftrl_sparse_table.h"
+#include "multiverso/codec.h"
 #include "multiverso/util/configure.h"
 
 namespace logreg {
@@ -35,6 +36,11 @@ PSModel<EleType>::PSModel(Configure& config) :
       this->worker_table_ = static_cast<multiverso::WorkerTable*>(
         multiverso::MV_CreateTable(SparseTableOption<EleType>(size)));
     }
+    // sparse keys are size_t, mostly sorted
+    if (this->worker_table_ != nullptr) {
+      multiverso::codec::SetTableCodec(this->worker_table_->table_id(),
+                                       multiverso::codec::kKeys64);
+    }
   } else {
     this->worker_table_ = static_cast<multiverso::WorkerTable*>(
       multiverso::MV_CreateTable(multiverso::ArrayTableOption<EleType>(size)));
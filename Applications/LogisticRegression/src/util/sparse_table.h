@@ -3,6 +3,7 @@
 
 #include "data_type.h"
 #include "multiverso/util/allocator.h"
+#include "multiverso/util/storage_allocator.h"
 #include "multiverso/table_interface.h"
 #include "multiverso/updater/updater.h"
 
@@ -290,7 +291,7 @@ protected:
   size_t offset_;
   size_t count_;
   std::vector<bool> keys_;
-  std::vector<EleType> storage_;
+  std::vector<EleType, multiverso::StorageAllocator<EleType>> storage_;
 };
 
 template<typename EleType>
@@ -334,6 +334,8 @@ namespace wordembedding {
   void DistributedWordembedding::Train(int argc, char *argv[]) {
     argc = 1;
     argv = nullptr;
+    multiverso::MV_SetFlag<std::string>("matrix_partition",
+      option_->matrix_partition);
     multiverso::MV_Init(&argc, argv);
     multiverso::Log::Info("MV Rank %d Init done.\n", multiverso::MV_Rank());
 
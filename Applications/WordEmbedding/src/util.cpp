@@ -26,6 +26,9 @@ namespace wordembedding {
     total_words = 0;
     max_preload_data_size = 8000000000LL;
     use_adagrad = false;
+    // words are sorted by frequency, interleave them so that the frequent
+    // ones are not all on the first server
+    matrix_partition = "interleaved";
   }
   //Input all the local model-arguments 
   void Option::ParseArgs(int argc, char* argv[]) {
@@ -51,6 +54,7 @@ namespace wordembedding {
       if (strcmp(argv[i], "-sw_file") == 0)  sw_file = argv[i + 1];
       if (strcmp(argv[i], "-use_adagrad") == 0) use_adagrad = (atoi(argv[i + 1]) != 0);
       if (strcmp(argv[i], "-is_pipeline") == 0) is_pipeline = (atoi(argv[i + 1]) != 0);
+      if (strcmp(argv[i], "-matrix_partition") == 0) matrix_partition = argv[i + 1];
 
     }
   }
@@ -77,6 +81,7 @@ namespace wordembedding {
     puts("-data_block_size : default 1MB, the maximum bytes which a data block will store");
     puts("-max_preload_data_size : default 8GB, the maximum data size(bytes) which multiverse_WordEmbedding will preload");
     puts("-is_pipeline : 0 or 1, whether to use pipeline");
+    puts("-matrix_partition : contiguous, interleaved or hashed, default interleaved, how the rows of the tables are spread over the servers");
     puts("-server_endpoint_file : default "", server ZMQ socket endpoint file in MPI - free version");
   }
 
@@ -102,6 +107,7 @@ namespace wordembedding {
     multiverso::Log::Info("init_learning_rate: %lf\n", init_learning_rate);
     multiverso::Log::Info("data_block_size: %lld\n", data_block_size);
     multiverso::Log::Info("is_pipeline: %d\n", is_pipeline);
+    multiverso::Log::Info("matrix_partition: %s\n", matrix_partition);
     multiverso::Log::Info("endpoints_file: %s\n", endpoints_file);
   }
 
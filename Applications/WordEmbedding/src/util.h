@@ -23,6 +23,7 @@ namespace wordembedding {
     const char* output_file;
     const char* sw_file;
     const char* endpoints_file;
+    const char* matrix_partition;
     bool hs, output_binary, cbow, stopwords;
     bool use_adagrad;
     bool is_pipeline;
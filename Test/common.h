@@ -14,6 +14,10 @@ void TestMatrix(int argc, char* argv[]);
 
 void TestNet(int argc, char* argv[]);
 
+void TestNetPerf(int argc, char* argv[]);
+
+void TestUpdaterPerf(int argc, char* argv[]);
+
 }  // namespace test
 }  // namespace multiverso
 
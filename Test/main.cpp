@@ -6,7 +6,8 @@
 using namespace multiverso::test;
 
 void PrintUsage() {
-  printf("Usage: multiverso.test kv|array|net|matrix|allreduce\n");
+  printf("Usage: multiverso.test "
+         "kv|array|net|net_perf|matrix|allreduce|updater_perf\n");
 }
 
 int main(int argc, char* argv[]) {
@@ -15,8 +16,10 @@ int main(int argc, char* argv[]) {
     if (strcmp(argv[1], "kv") == 0) TestKV(argc, argv);
     else if (strcmp(argv[1], "array") == 0) TestArray(argc, argv);
     else if (strcmp(argv[1], "net") == 0) TestNet(argc, argv);
+    else if (strcmp(argv[1], "net_perf") == 0) TestNetPerf(argc, argv);
     else if (strcmp(argv[1], "matrix") == 0) TestMatrix(argc, argv);
     else if (strcmp(argv[1], "allreduce") == 0) TestAllreduce(argc, argv);
+    else if (strcmp(argv[1], "updater_perf") == 0) TestUpdaterPerf(argc, argv);
     else {
       PrintUsage();
     }
@@ -0,0 +1,78 @@
+#include <multiverso/multiverso.h>
+#include <multiverso/net.h>
+#include <multiverso/util/configure.h>
+#include <multiverso/util/log.h>
+#include <multiverso/util/timer.h>
+
+namespace multiverso {
+namespace test {
+
+namespace {
+
+// rank 0 pushes num_msg messages shaped like a whole-table Add (a key blob
+// and a value blob of msg_size bytes) to rank 1, and waits for one ack
+double PushMessages(NetInterface* net, size_t msg_size, int num_msg) {
+  MessagePtr empty;
+  Timer timer;
+  if (net->rank() == 0) {
+    int whole_table = -1;
+    Blob keys(&whole_table, sizeof(int));
+    Blob values(msg_size);
+    memset(values.data(), 0, msg_size);
+    for (int i = 0; i < num_msg; ++i) {
+      MessagePtr msg(new Message());
+      msg->set_src(0);
+      msg->set_dst(1);
+      msg->set_type(MsgType::Request_Add);
+      msg->Push(keys);
+      msg->Push(values);
+      net->Send(msg);
+    }
+    MessagePtr ack(new Message());
+    while (net->Recv(&ack) == 0) net->Send(empty);
+  } else if (net->rank() == 1) {
+    int received = 0;
+    MessagePtr msg(new Message());
+    while (received < num_msg) {
+      if (net->Recv(&msg) > 0) ++received;
+    }
+    MessagePtr ack(new Message());
+    ack->set_src(1);
+    ack->set_dst(0);
+    ack->set_type(MsgType::Reply_Add);
+    while (net->Send(ack) == 0);
+  }
+  return timer.elapse();
+}
+
+}  // namespace
+
+// Compare the copying send path with the zero-copy one over message sizes
+void TestNetPerf(int argc, char* argv[]) {
+  NetInterface* net = NetInterface::Get();
+  net->Init(&argc, argv);
+  CHECK(net->size() >= 2);
+
+  const size_t kTotalBytes = 1ll << 30;
+  for (size_t msg_size = 1 << 10; msg_size <= (64 << 20); msg_size <<= 2) {
+    int num_msg = static_cast<int>(kTotalBytes / msg_size);
+    if (num_msg > 10000) num_msg = 10000;
+    if (num_msg < 16) num_msg = 16;
+    double elapse[2];
+    for (int zero_copy = 0; zero_copy < 2; ++zero_copy) {
+      SetCMDFlag<bool>("mpi_zero_copy_send", zero_copy != 0);
+      PushMessages(net, msg_size, 4);  // warm up
+      elapse[zero_copy] = PushMessages(net, msg_size, num_msg);
+    }
+    if (net->rank() == 0) {
+      double mb = static_cast<double>(msg_size) * num_msg / (1 << 20);
+      Log::Info("msg size = %10lld bytes, #msg = %5d, copy: %9.2f MB/s, "
+                "zero copy: %9.2f MB/s\n", static_cast<long long>(msg_size),
+                num_msg, mb * 1000 / elapse[0], mb * 1000 / elapse[1]);
+    }
+  }
+  net->Finalize();
+}
+
+}  // namespace test
+}  // namespace multiverso
@@ -0,0 +1,99 @@
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <multiverso/updater/sgd_updater.h>
+#include <multiverso/updater/updater_kernels.h>
+#include <multiverso/util/log.h>
+#include <multiverso/util/timer.h>
+
+namespace multiverso {
+namespace test {
+
+namespace {
+
+// Items updated per microsecond by kernel, which updates size items of
+// num_element elements, over about kTotal elements
+template <typename Kernel>
+double Throughput(size_t size, size_t num_element, Kernel kernel) {
+  const size_t kTotal = 1ll << 28;
+  int repeat = static_cast<int>(kTotal / num_element);
+  kernel();  // warm up
+  Timer timer;
+  for (int i = 0; i < repeat; ++i) kernel();
+  double elapse = timer.elapse();
+  return static_cast<double>(size) * repeat / (elapse * 1000 + 1e-9);
+}
+
+// Rows updated per microsecond by Update on each row, and by one UpdateRows,
+// for batches of kCount random rows of a table of about 16M elements
+void RowThroughput(const char* name, Updater<float>* updater,
+                   size_t num_col) {
+  const int kCount = 4096;
+  size_t num_row = (16 << 20) / num_col;
+  std::vector<float> data(num_row * num_col, 1.0f);
+  std::vector<float> delta(kCount * num_col, 0.001f);
+  std::vector<size_t> offsets(kCount);
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<size_t> dis(0, num_row - 1);
+  for (auto& offset : offsets) offset = dis(gen) * num_col;
+
+  double per_row = Throughput(kCount, kCount * num_col, [&]() {
+    for (int i = 0; i < kCount; ++i) {
+      updater->Update(num_col, data.data(), delta.data() + i * num_col,
+                      nullptr, offsets[i]);
+    }
+  });
+  double batched = Throughput(kCount, kCount * num_col, [&]() {
+    updater->UpdateRows(offsets.data(), kCount, num_col, data.data(),
+                        delta.data());
+  });
+  Log::Info("%-7s #col = %4lld, rows/us: per row %8.2f, batched %8.2f\n",
+            name, static_cast<long long>(num_col), per_row, batched);
+}
+
+}  // namespace
+
+// Compare the updater kernels of each instruction set the CPU runs, on
+// float rows of a few sizes, then Update row by row with UpdateRows
+void TestUpdaterPerf(int, char*[]) {
+  const char* isas[] = { "scalar", "avx2", "avx512" };
+  for (size_t size = 16; size <= (1 << 20); size <<= 4) {
+    std::vector<float> data(size, 1.0f), state(size, 1.0f);
+    std::vector<float> delta(size, 0.001f);
+    for (const char* isa : isas) {
+      if (!kernels::SetIsa(isa)) continue;
+      double add = Throughput(size, size, [&]() {
+        kernels::Add(size, data.data(), delta.data());
+      });
+      double sub = Throughput(size, size, [&]() {
+        kernels::Sub(size, data.data(), delta.data());
+      });
+      double momentum = Throughput(size, size, [&]() {
+        kernels::Momentum(size, data.data(), state.data(), delta.data(),
+                          0.9f);
+      });
+      double adagrad = Throughput(size, size, [&]() {
+        kernels::AdaGrad(size, data.data(), state.data(), delta.data(),
+                         0.1f, 0.1f, 1e-6f);
+      });
+      Log::Info("size = %8lld, %-6s elements/us: add %8.1f, sgd %8.1f, "
+                "momentum %8.1f, adagrad %8.1f\n",
+                static_cast<long long>(size), isa, add, sub, momentum,
+                adagrad);
+    }
+  }
+  kernels::SetIsa("auto");
+
+  // Row by row and batched updates of the updaters with a batched path
+  std::unique_ptr<Updater<float>> add(new Updater<float>());
+  std::unique_ptr<Updater<float>> sgd(new SGDUpdater<float>(0));
+  for (size_t num_col = 16; num_col <= 1024; num_col <<= 2) {
+    RowThroughput("default", add.get(), num_col);
+    RowThroughput("sgd", sgd.get(), num_col);
+  }
+}
+
+}  // namespace test
+}  // namespace multiverso
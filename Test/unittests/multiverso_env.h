@@ -3,11 +3,26 @@
 
 #include <multiverso/multiverso.h>
 
+#ifdef MULTIVERSO_USE_TCP
+#include <fstream>
+#include <string>
+#endif
+
 namespace multiverso {
 namespace test {
 
+// The TCP net takes its ranks from a machine file, here of a single one
+inline void SetMachineFile() {
+#ifdef MULTIVERSO_USE_TCP
+  const std::string machine_file = "multiversotests_machines";
+  std::ofstream(machine_file) << "127.0.0.1:56200\n";
+  MV_SetFlag<std::string>("machine_file", machine_file);
+#endif
+}
+
 struct MultiversoEnv {
   MultiversoEnv() {
+    SetMachineFile();
     MV_SetFlag("sync", false);
     MV_Init();
   }
@@ -19,6 +34,7 @@ struct MultiversoEnv {
 
 struct SyncMultiversoEnv {
   SyncMultiversoEnv() {
+    SetMachineFile();
     MV_SetFlag("sync", true);
     MV_Init();
   }
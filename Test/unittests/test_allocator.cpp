@@ -0,0 +1,115 @@
+#include <boost/test/unit_test.hpp>
+#include <multiverso/util/allocator.h>
+#include <multiverso/util/configure.h>
+#include <multiverso/util/storage_allocator.h>
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace multiverso {
+namespace test {
+
+BOOST_AUTO_TEST_SUITE(allocator)
+
+BOOST_AUTO_TEST_CASE(allocator_reuse) {
+  Allocator* allocator = Allocator::Get();
+  char* data = allocator->Alloc(100);
+  allocator->Free(data);
+  // same size class, from the cache of this thread
+  BOOST_CHECK_EQUAL(allocator->Alloc(128), data);
+  allocator->Free(data);
+}
+
+BOOST_AUTO_TEST_CASE(allocator_threads) {
+  Allocator* allocator = Allocator::Get();
+  const int kNumBlocks = 10000;
+  std::vector<char*> blocks(kNumBlocks);
+  std::thread producer([&]() {
+    for (int i = 0; i < kNumBlocks; ++i) {
+      blocks[i] = allocator->Alloc(64 << (i % 8));
+      memset(blocks[i], i & 0xff, 64);
+    }
+  });
+  producer.join();
+  // freed by another thread than the one that allocated
+  std::thread consumer([&]() {
+    for (int i = 0; i < kNumBlocks; ++i) {
+      BOOST_CHECK_EQUAL(blocks[i][63], static_cast<char>(i & 0xff));
+      allocator->Free(blocks[i]);
+    }
+  });
+  consumer.join();
+  for (int i = 0; i < kNumBlocks; ++i) {
+    blocks[i] = allocator->Alloc(64 << (i % 8));
+  }
+  for (int i = 0; i < kNumBlocks; ++i) allocator->Free(blocks[i]);
+}
+
+BOOST_AUTO_TEST_CASE(allocator_trim) {
+  SmartAllocator* allocator = static_cast<SmartAllocator*>(Allocator::Get());
+  // 1MB blocks are not kept by thread caches
+  const int kSizeClass = 20;
+  const long long kSize = 1 << kSizeClass;
+  SmartAllocator::Stats before, stats;
+  allocator->GetStats(kSizeClass, &before);
+  char* data = allocator->Alloc(kSize);
+  allocator->GetStats(kSizeClass, &stats);
+  BOOST_CHECK_EQUAL(stats.live, before.live + kSize);
+  BOOST_CHECK(stats.peak >= kSize);
+
+  allocator->Free(data);
+  allocator->GetStats(kSizeClass, &stats);
+  BOOST_CHECK_EQUAL(stats.live, before.live);
+  BOOST_CHECK(stats.cached >= kSize);
+
+  allocator->Trim();
+  allocator->GetStats(kSizeClass, &stats);
+  BOOST_CHECK_EQUAL(stats.cached, 0);
+  BOOST_CHECK_EQUAL(stats.total, stats.live);
+  BOOST_CHECK(Dashboard::Watch("ALLOCATOR").find("2^20") !=
+              std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(allocator_storage) {
+  // both small and huge page blocks come zeroed
+  for (size_t bytes : { static_cast<size_t>(1000),
+                        static_cast<size_t>(5 << 20) }) {
+    char* data = static_cast<char*>(storage::Allocate(bytes, true));
+    BOOST_CHECK(data[0] == 0 && data[bytes - 1] == 0);
+    memset(data, 1, bytes);
+    storage::Free(data, bytes, true);
+  }
+  std::vector<float, StorageAllocator<float>> storage(1 << 20);
+  BOOST_CHECK_EQUAL(storage[0], 0.0f);
+  BOOST_CHECK_EQUAL(storage[(1 << 20) - 1], 0.0f);
+}
+
+#if !defined(_WIN32) && defined(SYS_get_mempolicy)
+BOOST_AUTO_TEST_CASE(allocator_storage_numa_bind) {
+  SetCMDFlag("server_numa_node", 0);
+  for (bool huge_pages : { false, true }) {
+    size_t bytes = (5 << 20) + 100;
+    char* data = static_cast<char*>(storage::Allocate(bytes, huge_pages));
+    // policy of the mapping at data, MPOL_F_ADDR
+    int mode = -1;
+    unsigned long mask = 0;
+    BOOST_REQUIRE_EQUAL(syscall(SYS_get_mempolicy, &mode, &mask,
+                                sizeof(mask) * 8, data, 2), 0);
+    BOOST_CHECK_EQUAL(mode, 2);  // MPOL_BIND
+    BOOST_CHECK_EQUAL(mask, 1ul);
+    storage::Free(data, bytes, huge_pages);
+  }
+  SetCMDFlag("server_numa_node", -1);
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}  // namespace test
+}  // namespace multiverso
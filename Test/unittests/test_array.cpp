@@ -1,3 +1,6 @@
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <vector>
 #include <boost/test/unit_test.hpp>
 #include <multiverso/table/array_table.h>
@@ -43,6 +46,92 @@ BOOST_AUTO_TEST_CASE(array_access) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(array_async_slots) {
+  // fewer slots than ops in flight, new ops wait for the oldest
+  MV_SetFlag("table_async_slots", 4);
+  ArrayTableOption<int> option(10);
+  ArrayWorker<int>* small_table = MV_CreateTable(option);
+  MV_SetFlag("table_async_slots", 4096);
+
+  std::vector<int> delta(10, 1);
+  std::vector<int> ids;
+  for (int i = 0; i < 20; ++i) {
+    ids.push_back(small_table->AddAsync(delta.data(), delta.size()));
+  }
+  small_table->WaitAll(ids);
+  for (int id : ids) BOOST_CHECK(small_table->TryWait(id));
+
+  std::vector<int> model(10);
+  std::vector<int> get_ids(1, small_table->GetAsync(model.data(),
+                                                    model.size()));
+  BOOST_CHECK_EQUAL(small_table->WaitAny(get_ids), 0);
+  for (int i = 0; i < 10; ++i) BOOST_CHECK_EQUAL(model[i], 20);
+  delete small_table;
+}
+
+BOOST_AUTO_TEST_CASE(array_callback) {
+  std::vector<int> delta(10, 1);
+  std::vector<int> model(10);
+  std::mutex mutex;
+  std::condition_variable cv;
+  int done = 0;
+  auto count = [&]() {
+    std::lock_guard<std::mutex> lock(mutex);
+    ++done;
+    cv.notify_all();
+  };
+  table->Then(table->AddAsync(delta.data(), delta.size()), count);
+  int id = table->GetAsync(model.data(), model.size());
+  table->Then(id, count);
+  table->Wait(id);
+  // already done, run right away
+  table->Then(id, count);
+  std::unique_lock<std::mutex> lock(mutex);
+  BOOST_CHECK(cv.wait_for(lock, std::chrono::seconds(10),
+                          [&done]() { return done == 3; }));
+  for (int i = 0; i < 10; ++i) BOOST_CHECK_EQUAL(model[i], 1);
+}
+
+BOOST_AUTO_TEST_CASE(array_callback_full_ring) {
+  // a callback fills the ring, its ops are kept aside instead of waiting
+  // for the worker thread that runs the callback
+  MV_SetFlag("table_async_slots", 4);
+  ArrayTableOption<int> option(10);
+  ArrayWorker<int>* small_table = MV_CreateTable(option);
+  MV_SetFlag("table_async_slots", 4096);
+
+  std::vector<int> delta(10, 1);
+  integer_t all_key = -1;
+  Blob key(&all_key, sizeof(integer_t));
+  Blob val(delta.data(), sizeof(int) * delta.size());
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::vector<int> ids;
+  bool started = false;
+  small_table->WorkerTable::AddAsync(key, val, nullptr, [&]() {
+    std::vector<int> more;
+    for (int i = 0; i < 8; ++i) {
+      more.push_back(small_table->AddAsync(delta.data(), delta.size()));
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    ids = more;
+    started = true;
+    cv.notify_all();
+  });
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    BOOST_REQUIRE(cv.wait_for(lock, std::chrono::seconds(10),
+                              [&started]() { return started; }));
+  }
+  small_table->WaitAll(ids);
+  for (int id : ids) BOOST_CHECK(small_table->TryWait(id));
+
+  std::vector<int> model(10);
+  small_table->Get(model.data(), model.size());
+  for (int i = 0; i < 10; ++i) BOOST_CHECK_EQUAL(model[i], 9);
+  delete small_table;
+}
+
 BOOST_AUTO_TEST_CASE(array_partition) {
   std::unordered_map<int, std::vector<Blob>> result;
   std::vector<Blob> kv;
@@ -34,6 +34,74 @@ BOOST_AUTO_TEST_CASE(blob_access_test) {
   BOOST_CHECK_EQUAL(str_blob[4], 'o');
 }
 
+BOOST_AUTO_TEST_CASE(blob_view_test) {
+  int a[4] = { 0, 1, 2, 3 };
+  multiverso::Blob view;
+  {
+    multiverso::Blob blob(a, 4 * sizeof(int));
+    view = multiverso::Blob(blob, 2 * sizeof(int), 2 * sizeof(int));
+    BOOST_CHECK_EQUAL(view.size<int>(), 2);
+    BOOST_CHECK_EQUAL(view.data(), blob.data() + 2 * sizeof(int));
+
+    blob.As<int>(2) = 5;
+    BOOST_CHECK_EQUAL(view.As<int>(0), 5);
+  }
+  // the memory is kept alive by the view
+  BOOST_CHECK_EQUAL(view.As<int>(0), 5);
+  BOOST_CHECK_EQUAL(view.As<int>(1), 3);
+
+  multiverso::Blob copy(view);
+  multiverso::Blob nested(copy, sizeof(int), sizeof(int));
+  BOOST_CHECK_EQUAL(nested.As<int>(), 3);
+
+  multiverso::Blob empty(view, 0, 0);
+  BOOST_CHECK_EQUAL(empty.size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(blob_assign_test) {
+  multiverso::Blob blob(4);
+  blob.As<int>() = 7;
+  blob = blob;
+  BOOST_CHECK_EQUAL(blob.As<int>(), 7);
+
+  multiverso::Blob deep;
+  deep.CopyFrom(blob);
+  BOOST_CHECK(deep.data() != blob.data());
+  BOOST_CHECK_EQUAL(deep.As<int>(), 7);
+
+  blob = multiverso::Blob();
+  BOOST_CHECK_EQUAL(blob.size(), 0);
+  BOOST_CHECK_EQUAL(deep.As<int>(), 7);
+}
+
+namespace {
+void CountFree(void*, void* hint) { ++*static_cast<int*>(hint); }
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(blob_adopt_test) {
+  int a[2] = { 1, 2 };
+  int freed = 0;
+  {
+    multiverso::Blob blob(a, sizeof(a), CountFree, &freed);
+    BOOST_CHECK_EQUAL(blob.data(), reinterpret_cast<char*>(a));
+    multiverso::Blob view(blob, sizeof(int), sizeof(int));
+    multiverso::Blob copy;
+    copy = blob;
+    BOOST_CHECK_EQUAL(view.As<int>(), 2);
+    BOOST_CHECK_EQUAL(freed, 0);
+  }
+  BOOST_CHECK_EQUAL(freed, 1);
+}
+
+BOOST_AUTO_TEST_CASE(blob_wrap_test) {
+  int a[2] = { 1, 2 };
+  multiverso::Blob blob = multiverso::Blob::Wrap(a, sizeof(a));
+  BOOST_CHECK_EQUAL(blob.data(), reinterpret_cast<char*>(a));
+  multiverso::Blob view(blob, sizeof(int), sizeof(int));
+  a[1] = 3;
+  BOOST_CHECK_EQUAL(view.As<int>(), 3);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 }  // namespace test
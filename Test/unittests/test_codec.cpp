@@ -0,0 +1,83 @@
+#include <boost/test/unit_test.hpp>
+#include <multiverso/codec.h>
+
+#include <cstdint>
+#include <cstring>
+#include <random>
+
+namespace multiverso {
+namespace test {
+
+BOOST_AUTO_TEST_SUITE(wire_codec)
+
+BOOST_AUTO_TEST_CASE(codec_keys) {
+  Blob keys(1000 * sizeof(int32_t));
+  for (int i = 0; i < 1000; ++i) keys.As<int32_t>(i) = 3 * i - (i % 7) - 100;
+  Blob encoded;
+  BOOST_CHECK(codec::EncodeKeys(keys, sizeof(int32_t), &encoded));
+  BOOST_CHECK(encoded.size() < keys.size() / 2);
+  Blob decoded = codec::DecodeKeys(encoded, sizeof(int32_t));
+  BOOST_CHECK_EQUAL(decoded.size(), keys.size());
+  BOOST_CHECK(memcmp(decoded.data(), keys.data(), keys.size()) == 0);
+
+  Blob keys64(1000 * sizeof(size_t));
+  for (int i = 0; i < 1000; ++i) keys64.As<size_t>(i) = (1ull << 40) + 5 * i;
+  BOOST_CHECK(codec::EncodeKeys(keys64, sizeof(size_t), &encoded));
+  decoded = codec::DecodeKeys(encoded, sizeof(size_t));
+  BOOST_CHECK(memcmp(decoded.data(), keys64.data(), keys64.size()) == 0);
+
+  // random 32 bit keys do not pay off
+  std::mt19937 random(7);
+  for (int i = 0; i < 1000; ++i) keys.As<uint32_t>(i) = random();
+  BOOST_CHECK(!codec::EncodeKeys(keys, sizeof(int32_t), &encoded));
+}
+
+BOOST_AUTO_TEST_CASE(codec_compress) {
+  Blob values(100000 * sizeof(float));
+  memset(values.data(), 0, values.size());
+  for (int i = 0; i < 100000; i += 97) values.As<float>(i) = 0.5f * i;
+  Blob compressed;
+  BOOST_CHECK(codec::Compress(values, &compressed));
+  BOOST_CHECK(compressed.size() < values.size() / 4);
+  Blob decompressed = codec::Decompress(compressed);
+  BOOST_CHECK_EQUAL(decompressed.size(), values.size());
+  BOOST_CHECK(memcmp(decompressed.data(), values.data(), values.size()) == 0);
+
+  std::mt19937 random(7);
+  for (size_t i = 0; i < values.size<uint32_t>(); ++i) {
+    values.As<uint32_t>(i) = random();
+  }
+  BOOST_CHECK(!codec::Compress(values, &compressed));
+}
+
+BOOST_AUTO_TEST_CASE(codec_message) {
+  codec::SetTableCodec(0, codec::kKeys32 | codec::kValuesLZ);
+  MessagePtr msg = Message::Create();
+  msg->set_type(MsgType::Request_Add);
+  msg->set_table_id(0);
+  Blob keys(256 * sizeof(int32_t));
+  Blob values(256 * 64 * sizeof(float));
+  memset(values.data(), 0, values.size());
+  for (int i = 0; i < 256; ++i) {
+    keys.As<int32_t>(i) = i;
+    values.As<float>(i * 64) = 1.0f;
+  }
+  msg->Push(keys);
+  msg->Push(values);
+
+  codec::Encode(msg.get());
+  BOOST_CHECK(msg->codec() != 0);
+  BOOST_CHECK(msg->data()[0].size() < keys.size());
+  BOOST_CHECK(msg->data()[1].size() < values.size());
+  codec::Decode(msg.get());
+  BOOST_CHECK_EQUAL(msg->codec(), 0);
+  BOOST_CHECK(memcmp(msg->data()[0].data(), keys.data(), keys.size()) == 0);
+  BOOST_CHECK(memcmp(msg->data()[1].data(), values.data(),
+                     values.size()) == 0);
+  codec::SetTableCodec(0, codec::kNone);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}  // namespace test
+}  // namespace multiverso
@@ -0,0 +1,68 @@
+#include <cstring>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include <multiverso/communicator.h>
+
+namespace multiverso {
+namespace test {
+
+BOOST_AUTO_TEST_SUITE(communicator)
+
+BOOST_AUTO_TEST_CASE(communicator_batch_format) {
+  const size_t kHeaderInts = Message::kHeaderSize / sizeof(int);
+  // msgs of 0, 1 and 3 blobs, blobs of different sizes
+  const int kNumBlobs[] = { 0, 1, 3 };
+  std::vector<MessagePtr> msgs;
+  std::vector<std::vector<Blob>> blobs;
+  for (int i = 0; i < 3; ++i) {
+    MessagePtr msg(Message::Create());
+    msg->set_src(i);
+    msg->set_dst(7);
+    msg->set_type(i == 1 ? MsgType::Request_Add : MsgType::Request_Get);
+    msg->set_table_id(10 + i);
+    msg->set_msg_id(100 + i);
+    msg->set_codec(i);
+    blobs.emplace_back();
+    for (int j = 0; j < kNumBlobs[i]; ++j) {
+      Blob blob((j + 1) * 12 + i);
+      memset(blob.data(), i * 16 + j, blob.size());
+      blobs.back().push_back(blob);
+      msg->Push(blob);
+    }
+    msgs.push_back(std::move(msg));
+  }
+  std::vector<int> headers;
+  for (auto& msg : msgs) {
+    headers.insert(headers.end(), msg->header(),
+                   msg->header() + kHeaderInts);
+  }
+
+  MessagePtr batch = Communicator::Pack(&msgs);
+  BOOST_CHECK(msgs.empty());
+  BOOST_CHECK(batch->type() == MsgType::Comm_Batch);
+  // the meta blob, then the blobs of all msgs
+  BOOST_CHECK_EQUAL(batch->size(), 1 + 0 + 1 + 3);
+
+  std::vector<MessagePtr> unpacked;
+  Communicator::Unpack(batch, &unpacked);
+  BOOST_REQUIRE_EQUAL(unpacked.size(), 3);
+  for (int i = 0; i < 3; ++i) {
+    const int* header = headers.data() + i * kHeaderInts;
+    for (size_t k = 0; k < kHeaderInts; ++k) {
+      BOOST_CHECK_EQUAL(unpacked[i]->header()[k], header[k]);
+    }
+    BOOST_REQUIRE_EQUAL(unpacked[i]->size(), kNumBlobs[i]);
+    for (int j = 0; j < kNumBlobs[i]; ++j) {
+      Blob& blob = unpacked[i]->data()[j];
+      BOOST_CHECK_EQUAL(blob.size(), blobs[i][j].size());
+      for (size_t k = 0; k < blob.size(); ++k) {
+        BOOST_CHECK_EQUAL(blob[k], char(i * 16 + j));
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}  // namespace test
+}  // namespace multiverso
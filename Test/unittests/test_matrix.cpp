@@ -0,0 +1,230 @@
+#include <thread>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include <multiverso/table/matrix_table.h>
+#include <multiverso/table/row_partitioner.h>
+
+#include "multiverso_env.h"
+
+namespace multiverso {
+namespace test {
+
+struct MatrixTableEnv : public MultiversoEnv {
+  MatrixWorkerTable<int>* table;
+
+  MatrixTableEnv() : MultiversoEnv() {
+    MatrixTableOption<int> option(8, 4);
+    table = MV_CreateTable(option);
+  }
+
+  ~MatrixTableEnv() {
+    delete table;
+    table = nullptr;
+  }
+};
+
+BOOST_FIXTURE_TEST_SUITE(matrix_test, MatrixTableEnv)
+
+BOOST_AUTO_TEST_CASE(matrix_concurrent_get) {
+  // row i holds i in every column
+  std::vector<int> delta(8 * 4);
+  for (int i = 0; i < 8 * 4; ++i) delta[i] = i / 4;
+  table->Add(delta.data(), delta.size());
+
+  // every thread keeps several Gets of its own rows in flight
+  std::vector<std::thread> threads;
+  std::vector<bool> ok(4, true);
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([this, t, &ok]() {
+      for (int round = 0; round < 50; ++round) {
+        std::vector<std::vector<int>> rows(4, std::vector<int>(4, -1));
+        std::vector<int> ids;
+        for (int k = 0; k < 4; ++k) {
+          integer_t row_id = (t + k) % 8;
+          ids.push_back(table->GetAsync(row_id, rows[k].data(), 4));
+        }
+        table->WaitAll(ids);
+        for (int k = 0; k < 4; ++k) {
+          for (int v : rows[k]) ok[t] = ok[t] && v == (t + k) % 8;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  for (int t = 0; t < 4; ++t) BOOST_CHECK(ok[t]);
+
+  std::vector<int> model(8 * 4);
+  int whole = table->GetAsync(model.data(), model.size());
+  std::vector<int> row(4);
+  int one = table->GetAsync(3, row.data(), row.size());
+  table->Wait(one);
+  table->Wait(whole);
+  for (int i = 0; i < 8 * 4; ++i) BOOST_CHECK_EQUAL(model[i], delta[i]);
+  for (int v : row) BOOST_CHECK_EQUAL(v, 3);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+struct CombineAddsEnv {
+  CombineAddsEnv() {
+    SetMachineFile();
+    MV_SetFlag("sync", false);
+    MV_SetFlag("server_combine_adds", true);
+    MV_Init();
+  }
+
+  ~CombineAddsEnv() {
+    MV_ShutDown(false);
+    MV_SetFlag("server_combine_adds", false);
+  }
+};
+
+BOOST_FIXTURE_TEST_SUITE(matrix_combine_adds, CombineAddsEnv)
+
+BOOST_AUTO_TEST_CASE(matrix_combine_adds) {
+  MatrixTableOption<int> option(8, 4);
+  MatrixWorkerTable<int>* table = MV_CreateTable(option);
+  // many Adds of the same rows wait in the server at once
+  std::vector<integer_t> row_ids = { 5, 1, 5 };
+  std::vector<int> delta(3 * 4, 1);
+  std::vector<int> ids;
+  for (int i = 0; i < 100; ++i) {
+    ids.push_back(table->AddAsync(delta.data(), delta.size(),
+                                  row_ids.data(), 3));
+  }
+  table->WaitAll(ids);
+  std::vector<int> model(8 * 4);
+  table->Get(model.data(), model.size());
+  for (int i = 0; i < 8 * 4; ++i) {
+    int row = i / 4;
+    BOOST_CHECK_EQUAL(model[i], row == 5 ? 200 : row == 1 ? 100 : 0);
+  }
+  delete table;
+
+  // deltas of a row from several Adds are summed
+  MatrixServerTable<int> server(4, 2);
+  integer_t keys_a[] = { 3, 0 };
+  int values_a[] = { 1, 2, 3, 4 };
+  integer_t keys_b[] = { 3 };
+  int values_b[] = { 10, 20 };
+  std::vector<Blob> add_a = { Blob(keys_a, sizeof(keys_a)),
+                              Blob(values_a, sizeof(values_a)) };
+  std::vector<Blob> add_b = { Blob(keys_b, sizeof(keys_b)),
+                              Blob(values_b, sizeof(values_b)) };
+  server.ProcessAdds({ &add_a, &add_b });
+  integer_t whole_table = -1;
+  std::vector<Blob> result;
+  server.ProcessGet({ Blob(&whole_table, sizeof(integer_t)) }, &result);
+  int expected[] = { 3, 4, 0, 0, 0, 0, 11, 22 };
+  for (int i = 0; i < 8; ++i) {
+    BOOST_CHECK_EQUAL(result[1].As<int>(i), expected[i]);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+struct ServerThreadsEnv {
+  ServerThreadsEnv() {
+    SetMachineFile();
+    MV_SetFlag("sync", false);
+    MV_SetFlag("server_threads", 3);
+    MV_SetFlag("server_combine_adds", true);
+    MV_Init();
+  }
+
+  ~ServerThreadsEnv() {
+    MV_ShutDown(false);
+    MV_SetFlag("server_threads", 1);
+    MV_SetFlag("server_combine_adds", false);
+  }
+};
+
+BOOST_FIXTURE_TEST_SUITE(matrix_server_threads, ServerThreadsEnv)
+
+BOOST_AUTO_TEST_CASE(matrix_sharded) {
+  MatrixTableOption<int> option(10, 4);
+  MatrixWorkerTable<int>* table = MV_CreateTable(option);
+  // Adds of rows of every shard and of the whole table, with Gets between
+  std::vector<integer_t> row_ids = { 9, 0, 4, 9 };
+  std::vector<int> delta(4 * 4, 1);
+  std::vector<int> whole(10 * 4, 1);
+  std::vector<int> model(10 * 4);
+  for (int i = 0; i < 50; ++i) {
+    std::vector<int> ids;
+    ids.push_back(table->AddAsync(delta.data(), delta.size(),
+                                  row_ids.data(), 4));
+    ids.push_back(table->AddAsync(whole.data(), whole.size()));
+    table->WaitAll(ids);
+    std::vector<int> row(4);
+    table->Get(9, row.data(), row.size());
+    for (int v : row) BOOST_CHECK_EQUAL(v, 3 * (i + 1));
+  }
+  table->Get(model.data(), model.size());
+  for (int i = 0; i < 10 * 4; ++i) {
+    int row = i / 4;
+    BOOST_CHECK_EQUAL(model[i], 50 + (row == 9 ? 100 : row == 0 ||
+                                      row == 4 ? 50 : 0));
+  }
+  delete table;
+
+  // each shard applies and reads only its rows
+  MatrixServerTable<int> server(5, 2);
+  integer_t keys[] = { 4, 0, 2 };
+  int values[] = { 1, 2, 3, 4, 5, 6 };
+  std::vector<Blob> add = { Blob(keys, sizeof(keys)),
+                            Blob(values, sizeof(values)) };
+  server.AddShard({ &add }, 0, 3);
+  std::vector<Blob> get = { Blob(keys, sizeof(keys)) };
+  std::vector<Blob> result;
+  server.PrepareGet(get, &result);
+  for (int shard = 0; shard < 3; ++shard) {
+    server.GetShard(get, &result, shard, 3);
+  }
+  int expected[] = { 0, 0, 3, 4, 0, 0 };
+  for (int i = 0; i < 6; ++i) {
+    BOOST_CHECK_EQUAL(result[1].As<int>(i), expected[i]);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(row_partitioner)
+
+BOOST_AUTO_TEST_CASE(row_partitioner_modes) {
+  RowPartition modes[] = { RowPartition::kContiguous,
+    RowPartition::kInterleaved, RowPartition::kHashed };
+  for (RowPartition mode : modes) {
+    RowPartitioner partitioner(mode, 100, 3);
+    BOOST_CHECK_EQUAL(partitioner.num_server(), 3);
+    // every row has one place, and every place one row
+    std::vector<int> rows_of(3, 0);
+    for (integer_t row = 0; row < 100; ++row) {
+      int server = partitioner.ServerOf(row);
+      BOOST_REQUIRE(server >= 0 && server < 3);
+      integer_t local = partitioner.LocalRow(row);
+      BOOST_REQUIRE(local >= 0 && local < partitioner.NumRows(server));
+      BOOST_CHECK_EQUAL(partitioner.GlobalRow(server, local), row);
+      ++rows_of[server];
+    }
+    for (int server = 0; server < 3; ++server) {
+      BOOST_CHECK_EQUAL(rows_of[server], partitioner.NumRows(server));
+      BOOST_CHECK(rows_of[server] > 0);
+    }
+    BOOST_CHECK_EQUAL(partitioner.NumRows(3), 0);
+  }
+
+  // the hot rows at the top go to every server
+  RowPartitioner interleaved(RowPartition::kInterleaved, 100, 3);
+  for (integer_t row = 0; row < 3; ++row) {
+    BOOST_CHECK_EQUAL(interleaved.ServerOf(row), row);
+  }
+  // fewer rows than servers
+  RowPartitioner small(RowPartition::kContiguous, 2, 3);
+  BOOST_CHECK_EQUAL(small.num_server(), 2);
+  BOOST_CHECK_EQUAL(small.ServerOf(1), 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}  // namespace test
+}  // namespace multiverso
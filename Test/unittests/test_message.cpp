@@ -1,6 +1,8 @@
 #include <boost/test/unit_test.hpp>
 #include <multiverso/message.h>
 
+#include <thread>
+
 namespace multiverso {
 namespace test {
 
@@ -9,6 +11,9 @@ BOOST_AUTO_TEST_SUITE(message)
 BOOST_AUTO_TEST_CASE(message_access) {
   multiverso::Message msg;
   BOOST_CHECK_EQUAL(msg.data().size(), 0);
+  for (size_t i = 0; i < Message::kHeaderSize / sizeof(int); ++i) {
+    BOOST_CHECK_EQUAL(msg.header()[i], 0);
+  }
 
   msg.set_msg_id(0);
   BOOST_CHECK_EQUAL(msg.msg_id(), 0);
@@ -39,6 +44,34 @@ BOOST_AUTO_TEST_CASE(message_access) {
   BOOST_CHECK_EQUAL(reply_msg->type(), MsgType::Reply_Get);
 }
 
+BOOST_AUTO_TEST_CASE(message_pool) {
+  Message* recycled;
+  {
+    MessagePtr msg = Message::Create();
+    msg->set_src(1);
+    msg->Push(Blob(4));
+    recycled = msg.get();
+  }
+  MessagePtr msg = Message::Create();
+  BOOST_CHECK_EQUAL(msg.get(), recycled);
+  BOOST_CHECK_EQUAL(msg->src(), 0);
+  BOOST_CHECK_EQUAL(msg->size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(message_after_cache) {
+  // thread locals go in reverse order, so a msg held by one made before
+  // the msg cache of the thread is freed after the cache is gone
+  struct Holder {
+    MessagePtr msg;
+  };
+  std::thread thread([]() {
+    thread_local Holder holder;
+    holder.msg = Message::Create();
+    holder.msg->Push(Blob(4));
+  });
+  thread.join();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 }  // namespace test
@@ -0,0 +1,80 @@
+#include <boost/test/unit_test.hpp>
+#include <multiverso/util/mpsc_queue.h>
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace multiverso {
+namespace test {
+
+BOOST_AUTO_TEST_SUITE(mpsc_queue)
+
+BOOST_AUTO_TEST_CASE(mpsc_queue_order) {
+  MpscQueue<int> queue;
+  for (int i = 0; i < 5; ++i) queue.Push(i);
+  int item;
+  BOOST_CHECK(queue.TryPop(item));
+  BOOST_CHECK_EQUAL(item, 0);
+  std::vector<int> items;
+  BOOST_CHECK(queue.PopBatch(&items));
+  BOOST_CHECK_EQUAL(items.size(), 4);
+  for (int i = 0; i < 4; ++i) BOOST_CHECK_EQUAL(items[i], i + 1);
+  BOOST_CHECK(queue.Empty());
+  BOOST_CHECK(!queue.TimedPop(item, 1000));
+  queue.Exit();
+  BOOST_CHECK(!queue.Pop(item));
+}
+
+BOOST_AUTO_TEST_CASE(mpsc_queue_producers) {
+  MpscQueue<int> queue;
+  const int kNumProducers = 4;
+  const int kNumItems = 10000;
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kNumProducers; ++p) {
+    producers.emplace_back([&queue, p]() {
+      for (int i = 0; i < kNumItems; ++i) {
+        int item = p * kNumItems + i;
+        queue.Push(item);
+      }
+    });
+  }
+  // items of each producer come in the order pushed
+  std::vector<int> next(kNumProducers, 0);
+  std::vector<int> items;
+  int count = 0;
+  while (count < kNumProducers * kNumItems && queue.PopBatch(&items)) {
+    for (int item : items) {
+      int p = item / kNumItems;
+      BOOST_REQUIRE_EQUAL(item % kNumItems, next[p]);
+      ++next[p];
+    }
+    count += static_cast<int>(items.size());
+    items.clear();
+  }
+  for (auto& producer : producers) producer.join();
+  BOOST_CHECK_EQUAL(count, kNumProducers * kNumItems);
+  BOOST_CHECK(queue.Empty());
+}
+
+BOOST_AUTO_TEST_CASE(mpsc_queue_recycle) {
+  // nodes go back to the pool without holding on to their items
+  MpscQueue<std::shared_ptr<int>> queue;
+  std::weak_ptr<int> weak;
+  for (int round = 0; round < 300; ++round) {
+    std::shared_ptr<int> item(new int(round));
+    weak = item;
+    queue.Push(item);
+    std::shared_ptr<int> popped;
+    BOOST_REQUIRE(queue.TryPop(popped));
+    BOOST_REQUIRE_EQUAL(*popped, round);
+    popped.reset();
+    BOOST_REQUIRE(weak.expired());
+  }
+  BOOST_CHECK(queue.Empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}  // namespace test
+}  // namespace multiverso
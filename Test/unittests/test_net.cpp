@@ -0,0 +1,163 @@
+#include <boost/test/unit_test.hpp>
+#include <multiverso/message.h>
+#include <multiverso/net.h>
+#include <multiverso/net/shm_net.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace multiverso {
+namespace test {
+
+namespace {
+
+// blob sizes with and without padding, and an empty one
+const size_t kBlobSizes[] = { 3, 0, 8, 13, 1000 };
+
+MessagePtr MakeMessage(int msg_id) {
+  MessagePtr msg = Message::Create();
+  msg->set_src(1);
+  msg->set_dst(2);
+  msg->set_type(MsgType::Request_Add);
+  msg->set_table_id(3);
+  msg->set_msg_id(msg_id);
+  for (size_t size : kBlobSizes) {
+    Blob blob = size > 0 ? Blob(size) : Blob();
+    for (size_t i = 0; i < size; ++i) {
+      blob.data()[i] = static_cast<char>(i * 7 + msg_id);
+    }
+    msg->Push(blob);
+  }
+  return msg;
+}
+
+void CheckMessage(const MessagePtr& msg, int msg_id) {
+  BOOST_CHECK_EQUAL(msg->src(), 1);
+  BOOST_CHECK_EQUAL(msg->dst(), 2);
+  BOOST_CHECK_EQUAL(msg->type(), MsgType::Request_Add);
+  BOOST_CHECK_EQUAL(msg->table_id(), 3);
+  BOOST_CHECK_EQUAL(msg->msg_id(), msg_id);
+  BOOST_REQUIRE_EQUAL(msg->size(), sizeof(kBlobSizes) / sizeof(size_t));
+  for (size_t b = 0; b < msg->size(); ++b) {
+    const Blob& blob = msg->data()[b];
+    BOOST_REQUIRE_EQUAL(blob.size(), kBlobSizes[b]);
+    // blobs are views of the frame, aligned to 8 bytes
+    if (blob.size() > 0) {
+      BOOST_CHECK_EQUAL(reinterpret_cast<size_t>(blob.data()) % 8, 0);
+    }
+    for (size_t i = 0; i < blob.size(); ++i) {
+      BOOST_CHECK_EQUAL(blob.data()[i], static_cast<char>(i * 7 + msg_id));
+    }
+  }
+}
+
+// Concatenate the segments of msg, which begin with the frame size
+std::string Frame(MessagePtr& msg) {
+  std::vector<size_t> meta;
+  std::vector<net::Segment> segments;
+  size_t frame_size = net::FrameSegments(msg, &meta, &segments);
+  std::string bytes;
+  for (auto& segment : segments) bytes.append(segment.first, segment.second);
+  BOOST_CHECK_EQUAL(bytes.size(), sizeof(size_t) + frame_size);
+  return bytes;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(net)
+
+BOOST_AUTO_TEST_CASE(net_frame) {
+  MessagePtr msg = MakeMessage(5);
+  std::string bytes = Frame(msg);
+  size_t frame_size;
+  memcpy(&frame_size, bytes.data(), sizeof(size_t));
+  BOOST_REQUIRE_EQUAL(frame_size, bytes.size() - sizeof(size_t));
+
+  Blob frame(bytes.data() + sizeof(size_t), frame_size);
+  MessagePtr parsed;
+  multiverso::net::ParseFrame(frame, &parsed);
+  CheckMessage(parsed, 5);
+}
+
+BOOST_AUTO_TEST_CASE(net_frame_empty) {
+  MessagePtr msg = Message::Create();
+  msg->set_msg_id(7);
+  std::string bytes = Frame(msg);
+
+  Blob frame(bytes.data() + sizeof(size_t), bytes.size() - sizeof(size_t));
+  MessagePtr parsed = MakeMessage(0);
+  multiverso::net::ParseFrame(frame, &parsed);
+  BOOST_CHECK_EQUAL(parsed->msg_id(), 7);
+  BOOST_CHECK_EQUAL(parsed->size(), 0);
+}
+
+#ifndef _WIN32
+
+BOOST_AUTO_TEST_CASE(net_shm_ring) {
+  std::string name = "/multiverso_test_" + std::to_string(getpid());
+  ShmRing consumer, producer;
+  consumer.Open(name, 256, true);
+  producer.Open(name, 256, false);
+  consumer.Unlink();
+
+  char buf[512];
+  BOOST_CHECK_EQUAL(consumer.Read(buf, sizeof(buf)), 0);
+  memset(buf, 'a', sizeof(buf));
+  BOOST_CHECK_EQUAL(producer.Write(buf, sizeof(buf)), 256);
+  BOOST_CHECK_EQUAL(producer.Write(buf, 1), 0);
+  BOOST_CHECK_EQUAL(consumer.Read(buf, 100), 100);
+  BOOST_CHECK_EQUAL(producer.Write(buf, sizeof(buf)), 100);
+  BOOST_CHECK_EQUAL(consumer.Read(buf, sizeof(buf)), 256);
+  BOOST_CHECK_EQUAL(consumer.Read(buf, sizeof(buf)), 0);
+}
+
+// Frames larger than the ring go through in pieces, wrapping around
+BOOST_AUTO_TEST_CASE(net_shm_ring_frames) {
+  std::string name = "/multiverso_test_" + std::to_string(getpid());
+  ShmRing consumer, producer;
+  consumer.Open(name, 512, true);
+  producer.Open(name, 512, false);
+  consumer.Unlink();
+
+  const int kNumMsgs = 4;
+  std::string sent;
+  for (int i = 0; i < kNumMsgs; ++i) {
+    MessagePtr msg = MakeMessage(i);
+    sent += Frame(msg);
+  }
+  std::string received;
+  size_t written = 0;
+  char buf[300];
+  while (received.size() < sent.size()) {
+    written += producer.Write(sent.data() + written,
+                              std::min<size_t>(200, sent.size() - written));
+    received.append(buf, consumer.Read(buf, sizeof(buf)));
+  }
+  BOOST_REQUIRE(received == sent);
+
+  size_t offset = 0;
+  for (int i = 0; i < kNumMsgs; ++i) {
+    size_t frame_size;
+    memcpy(&frame_size, received.data() + offset, sizeof(size_t));
+    offset += sizeof(size_t);
+    Blob frame(received.data() + offset, frame_size);
+    offset += frame_size;
+    MessagePtr parsed;
+    multiverso::net::ParseFrame(frame, &parsed);
+    CheckMessage(parsed, i);
+  }
+  BOOST_CHECK_EQUAL(offset, received.size());
+}
+
+#endif  // _WIN32
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}  // namespace test
+}  // namespace multiverso
@@ -0,0 +1,87 @@
+#ifdef MULTIVERSO_USE_TCP
+
+#include <boost/test/unit_test.hpp>
+#include <multiverso/message.h>
+#include <multiverso/net/tcp_net.h>
+
+#include <cstring>
+#include <thread>
+
+namespace multiverso {
+namespace test {
+
+namespace {
+
+// Two ranks in this process, over localhost
+struct TcpNets {
+  TcpNets() {
+    int ranks[] = { 0, 1 };
+    char* endpoints[] = { endpoint0, endpoint1 };
+    BOOST_REQUIRE_EQUAL(net0.Bind(0, endpoint0), 0);
+    BOOST_REQUIRE_EQUAL(net1.Bind(1, endpoint1), 0);
+    // each one connects, then accepts the other
+    std::thread connect1([&]() { net1.Connect(ranks, endpoints, 2); });
+    net0.Connect(ranks, endpoints, 2);
+    connect1.join();
+  }
+
+  char endpoint0[32] = "127.0.0.1:56201";
+  char endpoint1[32] = "127.0.0.1:56202";
+  TcpNetWrapper net0;
+  TcpNetWrapper net1;
+};
+
+}  // namespace
+
+BOOST_FIXTURE_TEST_SUITE(tcp_net, TcpNets)
+
+// Sends more than the sockets take while the peer does not read. They must
+// not block, but be queued and written as the peer reads
+BOOST_AUTO_TEST_CASE(tcp_net_queue) {
+  const int kNumMsgs = 8;
+  const size_t kBlobSize = 4 << 20;
+  for (int i = 0; i < kNumMsgs; ++i) {
+    MessagePtr msg = Message::Create();
+    msg->set_src(0);
+    msg->set_dst(1);
+    msg->set_type(MsgType::Request_Add);
+    msg->set_table_id(0);
+    msg->set_msg_id(i);
+    Blob blob(kBlobSize);
+    memset(blob.data(), i, kBlobSize);
+    msg->Push(blob);
+    net0.Send(msg);
+  }
+  BOOST_CHECK(net0.Sending());
+
+  int received = 0;
+  while (received < kNumMsgs) {
+    MessagePtr msg;
+    if (net1.Recv(&msg) > 0) {
+      BOOST_CHECK_EQUAL(msg->msg_id(), received);
+      BOOST_REQUIRE_EQUAL(msg->size(), 1);
+      BOOST_REQUIRE_EQUAL(msg->data()[0].size(), kBlobSize);
+      BOOST_CHECK_EQUAL(msg->data()[0].data()[0], static_cast<char>(received));
+      BOOST_CHECK_EQUAL(msg->data()[0].data()[kBlobSize - 1],
+                        static_cast<char>(received));
+      ++received;
+    }
+    net0.SendPending();
+  }
+  BOOST_CHECK(!net0.Sending());
+}
+
+BOOST_AUTO_TEST_CASE(tcp_net_send_to) {
+  char send_buf[] = "hello";
+  char recv_buf[sizeof(send_buf)];
+  net1.SendTo(0, send_buf, sizeof(send_buf));
+  net0.RecvFrom(1, recv_buf, sizeof(recv_buf));
+  BOOST_CHECK_EQUAL(recv_buf, send_buf);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}  // namespace test
+}  // namespace multiverso
+
+#endif  // MULTIVERSO_USE_TCP
@@ -0,0 +1,167 @@
+#include <cmath>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include <multiverso/updater/adagrad_updater.h>
+#include <multiverso/updater/momentum_updater.h>
+#include <multiverso/updater/sgd_updater.h>
+#include <multiverso/updater/updater_kernels.h>
+#include <multiverso/updater/updater_state.h>
+
+#include "multiverso_env.h"
+
+namespace multiverso {
+namespace test {
+
+namespace {
+
+// Run update on the scalar kernels and on isa, from the same start, and
+// compare data and state
+template <typename T, typename Update>
+void CheckKernel(const char* isa, Update update) {
+  // odd size to take the scalar tail too
+  const size_t size = 101;
+  std::vector<T> delta(size);
+  for (size_t i = 0; i < size; ++i) delta[i] = static_cast<T>(i % 7) - 3;
+  std::vector<T> expected(size, 1), expected_state(size, 2);
+  std::vector<T> actual(size, 1), actual_state(size, 2);
+
+  BOOST_CHECK(kernels::SetIsa("scalar"));
+  update(expected.data(), expected_state.data(), delta.data());
+  BOOST_CHECK(kernels::SetIsa(isa));
+  update(actual.data(), actual_state.data(), delta.data());
+  for (size_t i = 0; i < size; ++i) {
+    BOOST_CHECK_SMALL(actual[i] - expected[i], static_cast<T>(1e-4));
+    BOOST_CHECK_SMALL(actual_state[i] - expected_state[i],
+                      static_cast<T>(1e-4));
+  }
+}
+
+template <typename T>
+void CheckKernels(const char* isa) {
+  const size_t n = 101;
+  CheckKernel<T>(isa, [n](T* data, T*, T* delta) {
+    kernels::Add(n, data, delta);
+  });
+  CheckKernel<T>(isa, [n](T* data, T*, T* delta) {
+    kernels::Sub(n, data, delta);
+  });
+  CheckKernel<T>(isa, [n](T* data, T* smooth, T* delta) {
+    kernels::Momentum(n, data, smooth, delta, 0.9f);
+  });
+  CheckKernel<T>(isa, [n](T* data, T* g_sqr, T* delta) {
+    kernels::AdaGrad(n, data, g_sqr, delta, 0.5f, 0.1f, 1e-6f);
+  });
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(updater)
+
+BOOST_AUTO_TEST_CASE(updater_kernels) {
+  const char* isas[] = { "scalar", "avx2", "avx512" };
+  for (const char* isa : isas) {
+    // skip what the CPU does not run
+    if (!kernels::SetIsa(isa)) continue;
+    BOOST_TEST_MESSAGE("updater kernels " << isa);
+    CheckKernels<float>(isa);
+    CheckKernels<double>(isa);
+  }
+  BOOST_CHECK(kernels::SetIsa("auto"));
+  BOOST_CHECK(!kernels::SetIsa("sse9"));
+}
+
+BOOST_AUTO_TEST_CASE(updater_state_lazy) {
+  // 1000 rows of 100, blocks of 3 rows
+  UpdaterState<float> state(100 * 1000, 100);
+  BOOST_CHECK_EQUAL(state.allocated(), 0);
+  int runs = 0;
+  state.ForEach(100, 100 * 5, [&runs](float* s, size_t index, size_t n) {
+    BOOST_CHECK_EQUAL(index, 0);
+    BOOST_CHECK_EQUAL(n, 100);
+    BOOST_CHECK_EQUAL(s[0], 0.0f);
+    ++runs;
+  });
+  BOOST_CHECK_EQUAL(runs, 1);
+  BOOST_CHECK_EQUAL(state.allocated(), 300);
+  // rows 2 to 4 run over two blocks
+  runs = 0;
+  state.ForEach(300, 100 * 2, [&runs](float*, size_t index, size_t n) {
+    BOOST_CHECK_EQUAL(index, runs == 0 ? 0 : 100);
+    BOOST_CHECK_EQUAL(n, runs == 0 ? 100 : 200);
+    ++runs;
+  });
+  BOOST_CHECK_EQUAL(runs, 2);
+  BOOST_CHECK_EQUAL(state.allocated(), 600);
+}
+
+BOOST_FIXTURE_TEST_CASE(updater_adagrad_state, MultiversoEnv) {
+  AdaGradUpdater<float> updater(100 * 1000, 100);
+  std::vector<float> data(100 * 1000, 0.0f), delta(100, 0.1f);
+  AddOption option;
+  option.set_learning_rate(0.1f);
+  option.set_rho(0.1f);
+  updater.Update(100, data.data(), delta.data(), &option, 100 * 7);
+  float first = data[100 * 7];
+  BOOST_CHECK(first < 0);
+  // the history kept from the first update makes the second step smaller,
+  // whichever worker it comes from
+  option.set_worker_id(option.worker_id() + 1);
+  updater.Update(100, data.data(), delta.data(), &option, 100 * 7);
+  float second = data[100 * 7] - first;
+  BOOST_CHECK(second < 0 && second > first);
+  BOOST_CHECK_EQUAL(data[0], 0.0f);
+}
+
+BOOST_FIXTURE_TEST_CASE(updater_momentum_state, MultiversoEnv) {
+  MomentumUpdater<double> updater(16 * 64, 16);
+  std::vector<double> data(16 * 64, 0.0), delta(16, 1.0);
+  AddOption option;
+  option.set_momentum(0.5f);
+  updater.Update(16, data.data(), delta.data(), &option, 16 * 3);
+  updater.Update(16, data.data(), delta.data(), &option, 16 * 3);
+  // smooth is 0.5, then 0.75
+  BOOST_CHECK_CLOSE(data[16 * 3], -1.25, 1e-9);
+}
+
+BOOST_FIXTURE_TEST_CASE(updater_update_rows, MultiversoEnv) {
+  // rows repeat, and the batch is large enough to run on several threads
+  const size_t num_col = 64;
+  const int count = 300;
+  std::vector<size_t> offsets(count);
+  std::vector<float> delta(count * num_col);
+  for (int i = 0; i < count; ++i) offsets[i] = (i * 7 % 50) * num_col;
+  for (size_t i = 0; i < delta.size(); ++i) delta[i] = (i % 13) * 0.5f;
+  AddOption option;
+  option.set_momentum(0.5f);
+
+  std::vector<Updater<float>*> updaters = {
+    new Updater<float>(), new SGDUpdater<float>(0),
+    // no batched path, goes row by row
+    new MomentumUpdater<float>(50 * num_col, num_col)
+  };
+  std::vector<Updater<float>*> row_updaters = {
+    new Updater<float>(), new SGDUpdater<float>(0),
+    new MomentumUpdater<float>(50 * num_col, num_col)
+  };
+  for (size_t u = 0; u < updaters.size(); ++u) {
+    std::vector<float> expected(50 * num_col, 1.0f);
+    std::vector<float> actual(50 * num_col, 1.0f);
+    for (int i = 0; i < count; ++i) {
+      row_updaters[u]->Update(num_col, expected.data(),
+                              delta.data() + i * num_col, &option,
+                              offsets[i]);
+    }
+    updaters[u]->UpdateRows(offsets.data(), count, num_col, actual.data(),
+                            delta.data(), &option);
+    for (size_t i = 0; i < actual.size(); ++i) {
+      BOOST_CHECK_EQUAL(actual[i], expected[i]);
+    }
+    delete updaters[u];
+    delete row_updaters[u];
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}  // namespace test
+}  // namespace multiverso
@@ -5,6 +5,7 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "multiverso/message.h"
 
@@ -12,7 +13,7 @@ namespace std { class thread; }
 
 namespace multiverso {
 
-template<typename T> class MtQueue;
+template<typename T> class MpscQueue;
 
 // The basic computation and communication unit in the system
 class Actor {
@@ -42,9 +43,11 @@ protected:
   // The default main is to receive msg from other actors and process
   // messages based on registered message handlers
   virtual void Main();
+  // Handle the msgs popped at once, one by one by their handlers
+  virtual void ProcessBatch(std::vector<MessagePtr>& msgs);
 
-  // message queue
-  std::unique_ptr<MtQueue<MessagePtr> > mailbox_;
+  // message queue, popped only by the thread of the actor
+  std::unique_ptr<MpscQueue<MessagePtr> > mailbox_;
   // message handlers function
   std::unordered_map<int, Handler> handlers_;
   bool is_working_;
@@ -10,10 +10,15 @@ namespace multiverso {
 
 // Manage a chunk of memory. Blob can share memory with other Blobs.
 // Never use external memory. All external memory should be managed by itself
+// A Blob may also be a view of part of another Blob's memory, which is kept
+// alive as long as any view of it exists
 class Blob {
 public:
+  // Releases adopted memory, same signature as zmq_free_fn
+  typedef void (*FreeFunc)(void* data, void* hint);
+
   // an empty blob
-  Blob() : data_(nullptr), size_(0) {}
+  Blob() : data_(nullptr), size_(0), memory_(nullptr), external_(nullptr) {}
 
   explicit Blob(size_t size);
 
@@ -22,6 +27,18 @@ public:
 
   Blob(void* data, size_t size);
 
+  // Refer to memory of the caller without copy or ownership. The caller
+  // keeps it alive as long as the Blob is used, e.g. until the request the
+  // Blob is sent with is waited
+  static Blob Wrap(void* data, size_t size);
+
+  // Adopt external memory without copy. free_func(data, hint) is called
+  // when the last Blob referring to it is gone
+  Blob(void* data, size_t size, FreeFunc free_func, void* hint);
+
+  // A view of [offset, offset + size) of rhs, sharing its memory. No copy
+  Blob(const Blob& rhs, size_t offset, size_t size);
+
   Blob(const Blob& rhs);
 
   ~Blob();
@@ -47,9 +64,17 @@ public:
   inline size_t size() const { return size_; }
 
 private:
+  void Refer();
+  void Release();
+
   // Memory is shared and auto managed
   char *data_;
   size_t size_;
+  // start of the allocation data_ points into, nullptr for an empty blob
+  char *memory_;
+  // refcount of adopted memory, nullptr if not adopted
+  struct External;
+  External *external_;
 };
 
 }  // namespace multiverso
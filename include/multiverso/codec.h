@@ -0,0 +1,47 @@
+#ifndef MULTIVERSO_CODEC_H_
+#define MULTIVERSO_CODEC_H_
+
+#include <cstddef>
+
+#include "multiverso/blob.h"
+#include "multiverso/message.h"
+
+namespace multiverso {
+
+// Wire codecs of table msgs, applied by the communicator to msgs leaving the
+// rank and undone on arrival. A blob is only encoded when that pays off, the
+// header tells the receiver which blobs were, so only senders need to agree
+// on the codecs of a table
+namespace codec {
+
+enum Codec {
+  kNone = 0,
+  // keys in the first blob, zigzag varint of the deltas between keys
+  kKeys32 = 1,  // integer_t keys
+  kKeys64 = 2,  // size_t keys
+  // other blobs, LZ compressed
+  kValuesLZ = 4
+};
+
+// Codecs of msgs of a table, -wire_codec for the tables not set. Tables
+// from 1024 on always use -wire_codec
+void SetTableCodec(int table_id, int codecs);
+int GetTableCodec(int table_id);
+
+// Encode the blobs of msg in place by the codecs of its table
+void Encode(Message* msg);
+// Restore the blobs of msg, nothing to do for msgs not encoded
+void Decode(Message* msg);
+
+// Return false, leaving out alone, if the encoded blob would not be
+// noticeably smaller than blob
+bool EncodeKeys(const Blob& keys, size_t key_size, Blob* out);
+Blob DecodeKeys(const Blob& encoded, size_t key_size);
+bool Compress(const Blob& blob, Blob* out);
+Blob Decompress(const Blob& compressed);
+
+}  // namespace codec
+
+}  // namespace multiverso
+
+#endif  // MULTIVERSO_CODEC_H_
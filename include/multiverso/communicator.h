@@ -1,18 +1,30 @@
 #ifndef MULTIVERSO_COMMUNICATION_H_
 #define MULTIVERSO_COMMUNICATION_H_
 
+#include <chrono>
+#include <memory>
+#include <vector>
+
 #include "multiverso/actor.h"
 #include "multiverso/message.h"
 
 namespace multiverso {
 
 class NetInterface;
+class PollMonitor;
 
 class Communicator : public Actor {
 public:
   Communicator();
   ~Communicator();
 
+  // Pack msgs into one Comm_Batch msg, without src and dst: a meta blob
+  // with the header and the number of blobs of each msg, then the blobs of
+  // all msgs in order. msgs is left empty
+  static MessagePtr Pack(std::vector<MessagePtr>* msgs);
+  // Split a Comm_Batch msg into the packed msgs
+  static void Unpack(MessagePtr& msg, std::vector<MessagePtr>* msgs);
+
 private:
   void Main() override;
   // Process message received from other actors, either send to other nodes, or
@@ -23,8 +35,29 @@ private:
   // Forward to other actors in the same node
   void LocalForward(MessagePtr& msg);
 
+  // Batching of small msgs to the same rank, on when comm_batch_size > 0
+  using Clock = std::chrono::steady_clock;
+  struct PendingBatch {
+    std::vector<MessagePtr> msgs;
+    size_t bytes;
+    Clock::time_point deadline;
+  };
+  // Main loop for THREAD_MULTIPLE net when batching
+  void BatchMain();
+  // Hold msg in the batch of its dst, or send it after the batch
+  void SendBatched(MessagePtr& msg);
+  // Pack the pending msgs to dst into one msg and send it
+  void Flush(int dst);
+  // Flush the batches whose deadline is passed, return microseconds to
+  // the next deadline, -1 if no batch is pending
+  long long FlushExpired();
+  void FlushAll();
+
   NetInterface* net_util_;
   std::unique_ptr<std::thread> recv_thread_;
+  // time of the polling loop, busy with msgs, spinning, or parked
+  std::unique_ptr<PollMonitor> poll_monitor_;
+  std::vector<PendingBatch> batches_;
 };
 
 }  // namespace multiverso
@@ -26,11 +26,12 @@ private:
 
 class Monitor {
 public:
-  explicit Monitor(const std::string& name) {
+  explicit Monitor(const std::string& name) : elapse_(0), count_(0) {
     name_ = name;
     timer_.Start();
     Dashboard::AddMonitor(name_, this);
   }
+  virtual ~Monitor() = default;
 
   void Begin() { timer_.Start(); }
 
@@ -45,7 +46,7 @@ public:
   double elapse() const { return elapse_; }
   int count() const { return count_; }
 
-  std::string info_string() const;
+  virtual std::string info_string() const;
 
 private:
   // name of the Monitor
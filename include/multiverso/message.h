@@ -20,22 +20,41 @@ enum MsgType {
   Control_Reply_Barrier = -33,
   Control_Register = 34,
   Control_Reply_Register = -34,
+  // small msgs to the same rank packed by the communicator
+  Comm_Batch = 40,
   Default = 0
 };
 
+class Message;
+
+// Returns a Message to the pool when a MessagePtr lets it go
+struct MessageDeleter {
+  void operator()(Message* msg) const;
+};
+
+typedef std::unique_ptr<Message, MessageDeleter> MessagePtr;
+
 class Message {
 public:
+  // A zeroed header, codec() is 0 when none is set
+  Message() : header_() {}
+  // Get a Message with a zeroed header from the pool
+  static MessagePtr Create();
+
   MsgType type() const { return static_cast<MsgType>(header_[2]); }
   inline int src() const { return header_[0]; }
   inline int dst() const { return header_[1]; }
   inline int table_id() const { return header_[3]; }
   inline int msg_id() const { return header_[4]; }
+  // codecs the blobs are encoded with on the wire, see codec.h
+  inline int codec() const { return header_[5]; }
 
   inline void set_type(MsgType type) { header_[2] = static_cast<int>(type); }
   inline void set_src(int src) { header_[0] = src; }
   inline void set_dst(int dst) { header_[1] = dst; }
   inline void set_table_id(int table_id) { header_[3] = table_id; }
   inline void set_msg_id(int msg_id) { header_[4] = msg_id; }
+  inline void set_codec(int codec) { header_[5] = codec; }
 
   inline void set_data(const std::vector<Blob>& data) { 
     data_ = std::move(data); }
@@ -48,15 +67,7 @@ public:
 
   // Create a Message with only headers
   // The src/dst, type is opposite with src message
-  inline Message* CreateReplyMessage() {
-    Message* reply = new Message();
-    reply->set_dst(this->src());
-    reply->set_src(this->dst());
-    reply->set_type(static_cast<MsgType>(-header_[2]));
-    reply->set_table_id(this->table_id());
-    reply->set_msg_id(this->msg_id());
-    return reply;
-  }
+  Message* CreateReplyMessage();
 
   inline void Push(const Blob& blob) { data_.push_back(blob); }
 
@@ -65,8 +76,6 @@ private:
   std::vector<Blob> data_;
 };
 
-typedef std::unique_ptr<Message> MessagePtr;
-
 }  // namespace multiverso
 
 #endif  // MULTIVERSO_MESSAGE_H_
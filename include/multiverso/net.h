@@ -2,6 +2,9 @@
 #define MULTIVERSO_NET_NET_H_
 
 #include <string>
+#include <utility>
+#include <vector>
+
 #include "multiverso/message.h"
 
 namespace multiverso {
@@ -33,10 +36,20 @@ public:
 
   // \return 1. > 0 sent size 2. = 0 not sent 3. < 0 net error
   virtual int Send(MessagePtr& msg) = 0;
+  // Move on the msgs given to earlier Send calls, for nets that do not send
+  // them all at once. Polled in the THREAD_SERIALIZED mode
+  // \return bytes sent
+  virtual int SendPending() { return 0; }
+  // Whether msgs given to Send are still queued or on the air
+  virtual bool Sending() const { return false; }
 
   // \return 1. > 0 received size 2. = 0 not received 3. < 0 net error
   virtual int Recv(MessagePtr* msg) = 0;
 
+  // Wait up to timeout_us, or less once there may be a msg to Recv. Nets
+  // not notified of arriving msgs just sleep, up to -comm_recv_park_us
+  virtual void WaitRecv(long long timeout_us);
+
   // Blocking, send raw data to rank
   virtual void SendTo(int rank, char* buf, int len) const = 0;
   // Blocking, receive raw data from rank 
@@ -54,6 +67,20 @@ namespace net {
 template <typename Typename>
 void Allreduce(Typename* data, size_t elem_count);
 
+// Msgs on byte streams are framed as: the frame size, the header, the number
+// of blobs, the blob sizes, then the blobs, each padded to 8 bytes so that
+// the received blobs are aligned views of the frame
+typedef std::pair<const char*, size_t> Segment;
+
+// Describe the frame of msg as segments to write in order. meta keeps the
+// sizes the segments refer to. Return the frame size
+size_t FrameSegments(MessagePtr& msg, std::vector<size_t>* meta,
+                     std::vector<Segment>* segments);
+
+// Fill msg from a frame received without its leading size, the blobs are
+// views of frame
+void ParseFrame(const Blob& frame, MessagePtr* msg);
+
 }
 
 }  // namespace multiverso
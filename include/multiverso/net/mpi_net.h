@@ -6,11 +6,13 @@
 #include "multiverso/net.h"
 
 #include <limits>
+#include <list>
 #include <mutex>
 #include <queue>
 
 #include "multiverso/message.h"
 #include "multiverso/dashboard.h"
+#include "multiverso/util/configure.h"
 #include "multiverso/util/log.h"
 #include "multiverso/util/mt_queue.h"
 
@@ -57,8 +59,20 @@ namespace {
 
 class MPINetWrapper : public NetInterface {
 public:
+  // flags are defined in mpi_net.cpp
   MPINetWrapper() : /* more_(std::numeric_limits<char>::max()) */ 
-   kover_(std::numeric_limits<size_t>::max()) {
+   kover_(std::numeric_limits<size_t>::max()),
+   zero_copy_send_(configure::FlagRegister<bool>::Get()
+     ->GetValue("mpi_zero_copy_send")),
+   send_window_(configure::FlagRegister<int>::Get()
+     ->GetValue("mpi_send_window")) {
+  }
+
+  // Blobs are padded to kAlignment on the wire, so that the received blobs,
+  // which are views of one receive buffer, are aligned for any element type
+  static const size_t kAlignment = sizeof(size_t);
+  static size_t Padding(size_t size) {
+    return (kAlignment - size % kAlignment) % kAlignment;
   }
 
   class MPIMsgHandle {
@@ -71,6 +85,10 @@ public:
     const MessagePtr& msg() const { return msg_; }
     void set_size(size_t size) { size_ = size; }
     size_t size() const { return size_; }
+    // serialized msg, owned by the handle until the send is completed
+    void set_buffer(const Blob& buffer) { buffer_ = buffer; }
+    // blob size fields referenced in place by a zero-copy send
+    std::vector<size_t>& blob_sizes() { return blob_sizes_; }
 
     void Wait() {
       // CHECK_NOTNULL(msg_.get());
@@ -83,16 +101,17 @@ public:
     int Test() {
       // CHECK_NOTNULL(msg_.get());
       int count = static_cast<int>(handles_.size());
-      MPI_Status* status = new MPI_Status[count];
       int flag;
-      MV_MPI_CALL(MPI_Testall(count, handles_.data(), &flag, status));
-      delete[] status;
+      MV_MPI_CALL(MPI_Testall(count, handles_.data(), &flag,
+                              MPI_STATUSES_IGNORE));
       return flag;
     }
   private:
     std::vector<MPI_Request> handles_;
     MessagePtr msg_;
     size_t size_;
+    Blob buffer_;
+    std::vector<size_t> blob_sizes_;
   };
 
   void Init(int* argc, char** argv) override {
@@ -192,29 +211,42 @@ public:
   //  return size;
   //}
 
+  // Up to mpi_send_window msgs are on the air at the same time, each one with
+  // its own buffer. They are started in queue order, and MPI does not let
+  // msgs between the same pair of ranks overtake each other, so the order to
+  // each destination is kept
   int Send(MessagePtr& msg) override {
     if (msg.get()) { send_queue_.Push(msg); }
-    
-    if (last_handle_.get() != nullptr && !last_handle_->Test()) {
-      // Last msg is still on the air
-      return 0;
-    }
+    return SendPending();
+  }
 
-    // send over, free the last msg
-    last_handle_.reset();
+  int SendPending() override {
+    // send over, free the finished msgs
+    for (auto it = inflight_.begin(); it != inflight_.end();) {
+      if ((*it)->Test()) {
+        it = inflight_.erase(it);
+      } else {
+        ++it;
+      }
+    }
 
-    // if there is more msg to send
-    if (send_queue_.Empty()) return 0;
-    
-    // Send a front msg of send queue
-    last_handle_.reset(new MPIMsgHandle()); 
+    // Send front msgs of send queue while the window is not full
+    int size = 0;
     MessagePtr sending_msg;
-    CHECK(send_queue_.TryPop(sending_msg));
-
-    int size = SerializeAndSend(sending_msg, last_handle_.get());
+    while ((inflight_.empty() ||
+            static_cast<int>(inflight_.size()) < send_window_) &&
+           send_queue_.TryPop(sending_msg)) {
+      MPIMsgHandle* handle = new MPIMsgHandle();
+      inflight_.emplace_back(handle);
+      size += SerializeAndSend(sending_msg, handle);
+    }
     return size;
   }
 
+  bool Sending() const override {
+    return !send_queue_.Empty() || !inflight_.empty();
+  }
+
   //size_t Recv(MessagePtr* msg) override {
   //  MPI_Status status;
   //  int flag;
@@ -235,10 +267,6 @@ public:
     if (!flag) return 0;
     int count;
     MV_MPI_CALL(MPI_Get_count(&status, MPI_BYTE, &count));
-    if (count > recv_size_) {
-      recv_buffer_ = (char*)realloc(recv_buffer_, count);
-      recv_size_ = count;
-    }
     // CHECK(count == Message::kHeaderSize);
     return RecvAndDeserialize(status.MPI_SOURCE, count, msg);
   }
@@ -289,55 +317,110 @@ public:
   int SerializeAndSend(MessagePtr& msg, MPIMsgHandle* msg_handle) {
 
     CHECK_NOTNULL(msg_handle);
+    if (zero_copy_send_) {
+      return ZeroCopySend(msg, msg_handle);
+    }
     MONITOR_BEGIN(MPI_NET_SEND_SERIALIZE);
     int size = sizeof(size_t) + Message::kHeaderSize;
     for (auto& data : msg->data()) 
-      size += static_cast<int>(sizeof(size_t) + data.size());
-    if (size > send_size_) {
-      send_buffer_ = (char*)realloc(send_buffer_, size);
-      send_size_ = size;
-    }
-    memcpy(send_buffer_, msg->header(), Message::kHeaderSize);
-    char* p = send_buffer_ + Message::kHeaderSize;
+      size += static_cast<int>(sizeof(size_t) + data.size() +
+                               Padding(data.size()));
+    Blob send_buffer(size);
+    memcpy(send_buffer.data(), msg->header(), Message::kHeaderSize);
+    char* p = send_buffer.data() + Message::kHeaderSize;
     for (auto& data : msg->data()) {
       size_t s = data.size();
       memcpy(p, &s, sizeof(size_t));
       p += sizeof(size_t);
       memcpy(p, data.data(), s);
       p += s;
+      memset(p, 0, Padding(s));
+      p += Padding(s);
     }
     size_t over = kover_; // std::numeric_limits<size_t>::max(); -1;
     memcpy(p, &over, sizeof(size_t));
     MONITOR_END(MPI_NET_SEND_SERIALIZE);
 
     MPI_Request handle;
-    MV_MPI_CALL(MPI_Isend(send_buffer_, static_cast<int>(size), MPI_BYTE, msg->dst(), 0, MPI_COMM_WORLD, &handle));
+    MV_MPI_CALL(MPI_Isend(send_buffer.data(), static_cast<int>(size), MPI_BYTE, msg->dst(), 0, MPI_COMM_WORLD, &handle));
     msg_handle->add_handle(handle);
+    msg_handle->set_buffer(send_buffer);
+    return size;
+  }
+
+  // Same wire format as SerializeAndSend, but the header and every blob are
+  // described in place by a hindexed datatype instead of being copied into
+  // a send buffer. The handle owns the message, so the blobs stay referenced
+  // until the send is completed
+  int ZeroCopySend(MessagePtr& msg, MPIMsgHandle* msg_handle) {
+    MONITOR_BEGIN(MPI_NET_SEND_ZERO_COPY)
+    int num_blobs = static_cast<int>(msg->size());
+    std::vector<size_t>& blob_sizes = msg_handle->blob_sizes();
+    blob_sizes.resize(num_blobs + 1);
+    static const char padding[kAlignment] = { 0 };
+    std::vector<int> lengths;
+    std::vector<MPI_Aint> displacements;
+    lengths.reserve(3 * num_blobs + 2);
+    displacements.reserve(3 * num_blobs + 2);
+    auto describe = [&](const void* data, size_t length) {
+      MPI_Aint address;
+      MV_MPI_CALL(MPI_Get_address(const_cast<void*>(data), &address));
+      lengths.push_back(static_cast<int>(length));
+      displacements.push_back(address);
+    };
+
+    int size = sizeof(size_t) + Message::kHeaderSize;
+    describe(msg->header(), Message::kHeaderSize);
+    for (int i = 0; i < num_blobs; ++i) {
+      Blob& data = msg->data()[i];
+      blob_sizes[i] = data.size();
+      describe(&blob_sizes[i], sizeof(size_t));
+      if (data.size() > 0) describe(data.data(), data.size());
+      if (Padding(data.size()) > 0) describe(padding, Padding(data.size()));
+      size += static_cast<int>(sizeof(size_t) + data.size() +
+                               Padding(data.size()));
+    }
+    blob_sizes[num_blobs] = kover_;
+    describe(&blob_sizes[num_blobs], sizeof(size_t));
+
+    MPI_Datatype datatype;
+    MV_MPI_CALL(MPI_Type_create_hindexed(static_cast<int>(lengths.size()),
+      lengths.data(), displacements.data(), MPI_BYTE, &datatype));
+    MV_MPI_CALL(MPI_Type_commit(&datatype));
+    MONITOR_END(MPI_NET_SEND_ZERO_COPY)
+
+    MPI_Request handle;
+    MV_MPI_CALL(MPI_Isend(MPI_BOTTOM, 1, datatype, msg->dst(), 0, MPI_COMM_WORLD, &handle));
+    // freeing is deferred by MPI until the pending send is done
+    MV_MPI_CALL(MPI_Type_free(&datatype));
+    msg_handle->add_handle(handle);
+    msg_handle->set_msg(msg);
     return size;
   }
 
   int RecvAndDeserialize(int src, int count, MessagePtr* msg_ptr) {
-    if (!msg_ptr->get()) msg_ptr->reset(new Message());
+    if (!msg_ptr->get()) *msg_ptr = Message::Create();
     MessagePtr& msg = *msg_ptr;
     msg->data().clear();
     MPI_Status status;
-    MV_MPI_CALL(MPI_Recv(recv_buffer_, count,
+    // A fresh buffer for every msg. The blobs of the msg are views of it, so
+    // it is released when the last of them is gone
+    Blob recv_buffer(count);
+    MV_MPI_CALL(MPI_Recv(recv_buffer.data(), count,
       MPI_BYTE, src, 0, MPI_COMM_WORLD, &status));
 
     MONITOR_BEGIN(MPI_NET_RECV_DESERIALIZE)
-    char* p = recv_buffer_;
+    char* p = recv_buffer.data();
+    size_t offset = Message::kHeaderSize;
     size_t s;
     memcpy(msg->header(), p, Message::kHeaderSize);
-    p += Message::kHeaderSize;
-    memcpy(&s, p, sizeof(size_t));
-    p += sizeof(size_t);
+    memcpy(&s, p + offset, sizeof(size_t));
+    offset += sizeof(size_t);
     while (s != kover_) {
-      Blob data(s);
-      memcpy(data.data(), p, data.size());
-      msg->Push(data);
-      p += data.size();
-      memcpy(&s, p, sizeof(size_t));
-      p += sizeof(size_t);
+      msg->Push(Blob(recv_buffer, offset, s));
+      offset += s + Padding(s);
+      memcpy(&s, p + offset, sizeof(size_t));
+      offset += sizeof(size_t);
     }
     MONITOR_END(MPI_NET_RECV_DESERIALIZE)
     return count;
@@ -377,7 +460,7 @@ private:
   //}
 
   //size_t RecvMsgFrom(int source, MessagePtr* msg_ptr) {
-  //  if (!msg_ptr->get()) msg_ptr->reset(new Message());
+  //  if (!msg_ptr->get()) *msg_ptr = Message::Create();
   //  MessagePtr& msg = *msg_ptr;
   //  msg->data().clear();
   //  MPI_Status status;
@@ -410,18 +493,16 @@ private:
 private:
   // const char more_;
   const size_t kover_;
+  const bool& zero_copy_send_;
+  const int& send_window_;
   std::mutex mutex_;
   int thread_provided_;
   int inited_;
   int rank_;
   int size_;
   // std::queue<MPIMsgHandle *> msg_handles_;
-  std::unique_ptr<MPIMsgHandle> last_handle_;
+  std::list<std::unique_ptr<MPIMsgHandle>> inflight_;
   MtQueue<MessagePtr> send_queue_;
-  char* send_buffer_;
-  long long send_size_;
-  char* recv_buffer_;
-  long long recv_size_;
 };
 
 }
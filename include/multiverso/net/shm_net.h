@@ -0,0 +1,111 @@
+#ifndef MULTIVERSO_NET_SHM_NET_H_
+#define MULTIVERSO_NET_SHM_NET_H_
+
+#ifndef _WIN32
+
+#include "multiverso/net.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "multiverso/message.h"
+
+namespace multiverso {
+
+// Single producer single consumer byte ring in POSIX shared memory. The
+// producer and the consumer may be in different processes
+class ShmRing {
+public:
+  ShmRing();
+  ~ShmRing();
+
+  // Map the ring of name, capacity is a power of 2. The consumer creates it
+  void Open(const std::string& name, size_t capacity, bool create);
+  // Remove the name, the mappings stay
+  void Unlink();
+
+  // Copy in up to size bytes, as many as there is room for, return the count
+  size_t Write(const char* src, size_t size);
+  // Copy out up to size bytes, as many as were written, return the count
+  size_t Read(char* dst, size_t size);
+
+  size_t capacity() const { return capacity_; }
+
+private:
+  struct Control;
+
+  std::string name_;
+  char* base_;
+  size_t mapped_;
+  Control* control_;
+  char* data_;
+  size_t capacity_;
+};
+
+// Msgs between ranks on the same host go through POSIX shared memory, one
+// single producer single consumer ring for each pair of local ranks. Msgs to
+// ranks on other hosts, and raw data of SendTo/RecvFrom, go through the
+// wrapped net. Hosts are told apart by host name, exchanged at Init
+class ShmNetWrapper : public NetInterface {
+public:
+  explicit ShmNetWrapper(NetInterface* remote);
+  ~ShmNetWrapper();
+
+  void Init(int* argc, char** argv) override;
+  void Finalize() override;
+
+  int Bind(int rank, char* endpoint) override;
+  int Connect(int* ranks, char* endpoints[], int size) override;
+
+  bool active() const override { return remote_->active(); }
+  std::string name() const override { return "SHM+" + remote_->name(); }
+  int size() const override { return remote_->size(); }
+  int rank() const override { return remote_->rank(); }
+
+  int Send(MessagePtr& msg) override;
+  int SendPending() override;
+  bool Sending() const override;
+  int Recv(MessagePtr* msg) override;
+
+  void SendTo(int rank, char* buf, int len) const override;
+  void RecvFrom(int rank, char* buf, int len) const override;
+  void SendRecv(int send_rank, char* send_buf, int send_len,
+    int recv_rank, char* recv_buf, int recv_len) const override;
+
+  // Outgoing msgs are streamed into the rings by SendPending calls, so it
+  // has to be polled as in the THREAD_SERIALIZED mode
+  int thread_level_support() override {
+    return NetThreadLevel::THREAD_SERIALIZED;
+  }
+
+private:
+  struct Outgoing;
+  struct Incoming;
+
+  // Find the ranks on this host, and a name for the shared memory of the job
+  void ExchangeHosts();
+  void Barrier();
+  void OpenRings();
+  void CloseRings();
+  // Write as much of the msgs to dst as its ring takes, return bytes written
+  int SendLocal(int dst);
+  // Read from the ring of src, return the msg size once a msg is complete
+  int RecvLocal(int src, MessagePtr* msg);
+
+  NetInterface* remote_;
+  std::string job_name_;
+  std::vector<std::string> hosts_;
+  // rings to and from each local rank, nullptr for remote ranks and self
+  std::vector<std::unique_ptr<Outgoing>> outgoing_;
+  std::vector<std::unique_ptr<Incoming>> incoming_;
+  std::vector<int> local_ranks_;
+  size_t next_local_;
+  bool remote_first_;
+};
+
+}  // namespace multiverso
+
+#endif  // _WIN32
+
+#endif  // MULTIVERSO_NET_SHM_NET_H_
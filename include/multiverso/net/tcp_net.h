@@ -0,0 +1,101 @@
+#ifndef MULTIVERSO_NET_TCP_NET_H_
+#define MULTIVERSO_NET_TCP_NET_H_
+
+#ifdef MULTIVERSO_USE_TCP
+
+#include "multiverso/net.h"
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "multiverso/message.h"
+
+namespace multiverso {
+
+// Plain TCP net on Linux, without MPI or ZeroMQ. Ranks are the entries of the
+// machine file, as for ZeroMQ. Each rank sends to a peer over a pool of
+// tcp_connections sockets, msgs of one table always go through the same one.
+// All sockets are non-blocking and polled with epoll. What a socket does not
+// take at once is queued on its connection, and written once it is writable
+// by Send, SendPending or Recv. WaitRecv returns as soon as an incoming
+// socket has data or an outgoing one with a queue is writable
+class TcpNetWrapper : public NetInterface {
+public:
+  TcpNetWrapper();
+  ~TcpNetWrapper();
+
+  void Init(int* argc, char** argv) override;
+  void Finalize() override;
+
+  int Bind(int rank, char* endpoint) override;
+  int Connect(int* ranks, char* endpoints[], int size) override;
+
+  bool active() const override { return active_; }
+  std::string name() const override { return "TCP"; }
+  int size() const override { return size_; }
+  int rank() const override { return rank_; }
+
+  // Called by one thread, while SendTo may be called by others
+  int Send(MessagePtr& msg) override;
+  int SendPending() override;
+  bool Sending() const override;
+  int Recv(MessagePtr* msg) override;
+  void WaitRecv(long long timeout_us) override;
+
+  void SendTo(int rank, char* buf, int len) const override;
+  void RecvFrom(int rank, char* buf, int len) const override;
+  void SendRecv(int send_rank, char* send_buf, int send_len,
+    int recv_rank, char* recv_buf, int recv_len) const override;
+
+  int thread_level_support() override {
+    return NetThreadLevel::THREAD_MULTIPLE;
+  }
+
+private:
+  struct Pending;
+  struct Outgoing;
+  struct Incoming;
+
+  // Listen on endpoint "ip:port", return false if it can not be bound
+  bool Listen(const std::string& endpoint);
+  // Open the pools to all peers and accept theirs
+  void ConnectAll();
+  // Queue pending on out and write what the sockets take to its rank
+  int Enqueue(Outgoing* out, Pending* pending) const;
+  // Write what the sockets to rank take, return bytes written
+  int Flush(int rank) const;
+  // Write the queue of out up to an entry waiting for another connection,
+  // under the mutex of out
+  int FlushLocked(Outgoing* out) const;
+  // Read what is available from in, return the msg size once a msg is
+  // complete
+  int RecvFrame(Incoming* in, MessagePtr* msg);
+  // Copy up to size bytes from the buffered or the available data of in
+  size_t Fill(Incoming* in, char* dst, size_t size) const;
+  void Close(Incoming* in);
+
+  bool active_;
+  int rank_;
+  int size_;
+  std::vector<std::string> endpoints_;
+  int listen_fd_;
+  int epoll_fd_;
+  // outgoing sockets, itself in epoll_fd_
+  int send_epoll_fd_;
+  // connections to and from each rank, empty for self
+  std::vector<std::vector<std::unique_ptr<Outgoing>>> outgoing_;
+  std::vector<std::vector<std::unique_ptr<Incoming>>> incoming_;
+  // for each rank, the msgs queued on its first connection up to the last
+  // msg sent on all of them, which later table msgs go after
+  std::vector<unsigned long long> fence_;
+  // incoming connections which may have data to read
+  std::deque<Incoming*> ready_;
+};
+
+}  // namespace multiverso
+
+#endif  // MULTIVERSO_USE_TCP
+
+#endif  // MULTIVERSO_NET_TCP_NET_H_
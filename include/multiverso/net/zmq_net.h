@@ -7,6 +7,7 @@
 
 #include <limits>
 #include <thread>
+#include <vector>
 
 #include "multiverso/message.h"
 #include "multiverso/util/log.h"
@@ -25,7 +26,7 @@ public:
   void Init(int* argc, char** argv) override {
     // get machine file 
     if (active_) return;
-    ParseMachineFile(MV_CONFIG_machine_file, &machine_lists_);
+    net::ParseMachineFile(MV_CONFIG_machine_file, &machine_lists_);
     int port = MV_CONFIG_port; 
 
     size_ = static_cast<int>(machine_lists_.size());
@@ -138,35 +139,52 @@ public:
   int size() const override { return size_; }
   std::string name() const override { return "ZeroMQ"; }
 
+  // A msg is sent as the header frame, one frame with the sizes of all
+  // blobs, and one frame per blob. The blob frames are handed to zmq
+  // without copy, each keeps a reference of its Blob until zmq is done
   int Send(MessagePtr& msg) override {
     int size = 0;
     int dst = msg->dst();
     void* socket = senders_[dst].socket;
     CHECK_NOTNULL(socket);
+    int num_blobs = static_cast<int>(msg->data().size());
     int send_size;
     send_size = zmq_send(socket, msg->header(), 
-      Message::kHeaderSize, msg->data().size() > 0 ? ZMQ_SNDMORE : 0);
+      Message::kHeaderSize, num_blobs > 0 ? ZMQ_SNDMORE : 0);
     CHECK(Message::kHeaderSize == send_size);
     size += send_size;
-    for (size_t i = 0; i < msg->data().size(); ++i) {
-      Blob blob = msg->data()[i];
-      size_t blob_size = blob.size();
-      CHECK_NOTNULL(blob.data());
-      send_size = zmq_send(socket, &blob_size, sizeof(size_t), ZMQ_SNDMORE);
-      CHECK(send_size == sizeof(size_t));
-      send_size = zmq_send(socket, blob.data(), static_cast<int>(blob.size()),
-        i == msg->data().size() - 1 ? 0 : ZMQ_SNDMORE);
-      CHECK(send_size == blob_size);
-      size += static_cast<int>(blob_size + sizeof(size_t));
+    if (num_blobs == 0) return size;
+
+    std::vector<size_t> blob_sizes(num_blobs);
+    for (int i = 0; i < num_blobs; ++i) {
+      blob_sizes[i] = msg->data()[i].size();
+    }
+    send_size = zmq_send(socket, blob_sizes.data(),
+      num_blobs * sizeof(size_t), ZMQ_SNDMORE);
+    CHECK(send_size == num_blobs * sizeof(size_t));
+    size += send_size;
+
+    for (int i = 0; i < num_blobs; ++i) {
+      Blob& blob = msg->data()[i];
+      zmq_msg_t frame;
+      if (blob.size() == 0) {
+        CHECK(zmq_msg_init(&frame) == 0);
+      } else {
+        CHECK(zmq_msg_init_data(&frame, blob.data(), blob.size(),
+                                ReleaseBlob, new Blob(blob)) == 0);
+      }
+      send_size = zmq_msg_send(&frame, socket,
+        i == num_blobs - 1 ? 0 : ZMQ_SNDMORE);
+      CHECK(send_size == blob.size());
+      size += send_size;
     }
     return size;
   }
 
   int Recv(MessagePtr* msg_ptr) override {
-    if (!msg_ptr->get()) msg_ptr->reset(new Message());
+    if (!msg_ptr->get()) *msg_ptr = Message::Create();
     int size = 0;
     int recv_size;
-    size_t blob_size;
     int more;
     size_t more_size = sizeof(more);
     // Receiving a Message from multiple zmq_recv
@@ -180,23 +198,47 @@ public:
 
     size += recv_size;
     zmq_getsockopt(receiver_.socket, ZMQ_RCVMORE, &more, &more_size);
+    if (!more) return size;
 
-    while (more) {
-      recv_size = zmq_recv(receiver_.socket, &blob_size, sizeof(size_t), 0);
-      CHECK(recv_size == sizeof(size_t));
-      size += recv_size;
+    zmq_msg_t sizes_frame;
+    CHECK(zmq_msg_init(&sizes_frame) == 0);
+    recv_size = zmq_msg_recv(&sizes_frame, receiver_.socket, 0);
+    CHECK(recv_size > 0 && recv_size % sizeof(size_t) == 0);
+    size += recv_size;
+    std::vector<size_t> blob_sizes(recv_size / sizeof(size_t));
+    memcpy(blob_sizes.data(), zmq_msg_data(&sizes_frame), recv_size);
+    zmq_msg_close(&sizes_frame);
+
+    for (size_t blob_size : blob_sizes) {
       zmq_getsockopt(receiver_.socket, ZMQ_RCVMORE, &more, &more_size);
       CHECK(more);
-      Blob blob(blob_size);
-      recv_size = zmq_recv(receiver_.socket, blob.data(), blob.size(), 0);
+      zmq_msg_t* frame = new zmq_msg_t();
+      CHECK(zmq_msg_init(frame) == 0);
+      recv_size = zmq_msg_recv(frame, receiver_.socket, 0);
       CHECK(recv_size == blob_size);
       size += recv_size;
-      msg->Push(blob);
-      zmq_getsockopt(receiver_.socket, ZMQ_RCVMORE, &more, &more_size);
+      char* data = static_cast<char*>(zmq_msg_data(frame));
+      if (blob_size == 0) {
+        msg->Push(Blob());
+        ReleaseFrame(nullptr, frame);
+      } else if (reinterpret_cast<size_t>(data) % sizeof(size_t) != 0) {
+        // keep blobs aligned for any element type
+        msg->Push(Blob(data, blob_size));
+        ReleaseFrame(nullptr, frame);
+      } else {
+        msg->Push(Blob(data, blob_size, ReleaseFrame, frame));
+      }
     }
     return size;
   }
 
+  // zmq_poll takes milliseconds, shorter waits are rounded up as a msg
+  // arriving ends the poll anyway
+  void WaitRecv(long long timeout_us) override {
+    zmq_pollitem_t item = { receiver_.socket, 0, ZMQ_POLLIN, 0 };
+    long timeout_ms = static_cast<long>((timeout_us + 999) / 1000);
+    zmq_poll(&item, 1, timeout_ms);
+  }
 
   void SendTo(int rank, char* buf, int len) const override {
     int send_size = 0;
@@ -231,26 +273,13 @@ public:
   }
 
 protected:
-  void ParseMachineFile(std::string filename, 
-                        std::vector<std::string>* result) {
-    CHECK_NOTNULL(result);
-    FILE* file;
-    char str[32];
-    int i = 0;
-#ifdef _MSC_VER
-    fopen_s(&file, filename.c_str(), "r");
-#else
-    file = fopen(filename.c_str(), "r");
-#endif
-    CHECK_NOTNULL(file);
-#ifdef _MSC_VER
-    while (fscanf_s(file, "%s", &str, 32) > 0) {
-#else
-    while (fscanf(file, "%s", &str) > 0) {
-#endif
-      result->push_back(str);
-    }
-    fclose(file);
+  static void ReleaseBlob(void*, void* blob) {
+    delete static_cast<Blob*>(blob);
+  }
+
+  static void ReleaseFrame(void*, void* frame) {
+    zmq_msg_close(static_cast<zmq_msg_t*>(frame));
+    delete static_cast<zmq_msg_t*>(frame);
   }
 
   bool active_;
@@ -1,6 +1,7 @@
 #ifndef MULTIVERSO_SERVER_H_
 #define MULTIVERSO_SERVER_H_
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -13,14 +14,43 @@ class ServerTable;
 class Server : public Actor {
 public:
   Server();
+  ~Server();
   static Server* GetServer();
   int RegisterTable(ServerTable* table);
 
 protected:
+  // With -server_threads above 1, requests are executed by that many
+  // executor threads. Those of a sharded table go to every executor, each
+  // executing them for the rows of its shard. Those of other tables go to
+  // one executor for each table. Executors keep the order of arrival
+  void Main() override;
+  void ProcessBatch(std::vector<MessagePtr>& msgs) override;
   virtual void ProcessGet(MessagePtr& msg);
   virtual void ProcessAdd(MessagePtr& msg);
 
   std::vector<ServerTable*> store_;
+  // With -server_combine_adds, the Adds to a table waiting in a batch, up
+  // to the next Get of the table, are applied at once
+  bool combine_adds_;
+
+private:
+  class Executor;
+  struct ShardedRequest;
+
+  void Dispatch(MessagePtr& msg);
+  // Execute the Gets and Adds of a batch in order, combining Adds if set
+  void ExecuteBatch(std::vector<MessagePtr>& msgs);
+  void ExecuteGet(MessagePtr& msg);
+  void ExecuteAdd(MessagePtr& msg);
+  // Adds of one table
+  void ExecuteAdds(std::vector<MessagePtr>& msgs);
+  // ExecuteBatch of requests of sharded tables, for the rows of shard
+  void ExecuteShard(std::vector<std::shared_ptr<ShardedRequest>>& requests,
+                    int shard);
+  // Reply once all shards have executed request
+  void FinishShard(ShardedRequest* request);
+
+  std::vector<std::unique_ptr<Executor>> executors_;
 };
 
 }  // namespace multiverso
@@ -1,9 +1,12 @@
 #ifndef MULTIVERSO_ARRAY_TABLE_H_
 #define MULTIVERSO_ARRAY_TABLE_H_
 
+#include <algorithm>
+
 #include "multiverso/multiverso.h"
 #include "multiverso/table_interface.h"
 #include "multiverso/util/log.h"
+#include "multiverso/util/storage_allocator.h"
 
 namespace multiverso {
 
@@ -54,12 +57,28 @@ public:
   void ProcessGet(const std::vector<Blob>& data,
                   std::vector<Blob>* result) override;
 
+  // Shards are ranges of the elements of this server
+  bool Sharded() const override { return true; }
+  void PrepareGet(const std::vector<Blob>& data,
+                  std::vector<Blob>* result) override;
+  void GetShard(const std::vector<Blob>& data, std::vector<Blob>* result,
+                int shard, int num_shards) override;
+  void AddShard(const std::vector<const std::vector<Blob>*>& adds,
+                int shard, int num_shards) override;
+
   void Store(Stream* s) override;
   void Load(Stream* s) override;
 
 private:
+  // The elements [begin, end) of a shard of num_shards
+  void ShardRange(int shard, int num_shards, size_t* begin, size_t* end) const {
+    size_t shard_size = (size_ + num_shards - 1) / num_shards;
+    *begin = std::min(size_, shard_size * shard);
+    *end = std::min(size_, shard_size * (shard + 1));
+  }
+
   int32_t server_id_;
-  std::vector<T> storage_;
+  std::vector<T, StorageAllocator<T>> storage_;
   Updater<T>* updater_;
   size_t size_; // number of element with type T
   
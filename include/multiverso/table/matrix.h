@@ -3,6 +3,8 @@
 
 #include "multiverso/multiverso.h"
 #include "multiverso/table_interface.h"
+#include "multiverso/table/row_index.h"
+#include "multiverso/util/storage_allocator.h"
 
 #include <vector>
 
@@ -56,11 +58,17 @@ namespace multiverso {
       MsgType partition_type,
       std::unordered_map<int, std::vector<Blob>>* out) override;
 
-    void ProcessReplyGet(std::vector<Blob>& reply_data) override;
+    void ProcessReplyGet(std::vector<Blob>& reply_data, int msg_id) override;
 
   protected:
-    T** row_index_;
-    int get_reply_count_;                    // number of unprocessed get reply
+    // Start a Get of keys, the rows replied are written where row_index
+    // says. Any number of Gets may be in flight, from any threads
+    int StartGet(Blob keys, RowIndex<T> row_index, const GetOption* option);
+    void ProcessDone(int msg_id) override;
+
+    // row indexes of the Gets in flight, by msg id
+    std::unordered_map<int, RowIndex<T>> row_indexes_;
+    std::mutex* row_indexes_mutex_;
     integer_t num_row_;
     integer_t num_col_;
     integer_t row_size_;                           // equals to sizeof(T) * num_col_
@@ -105,7 +113,7 @@ namespace multiverso {
     integer_t num_col_;
     integer_t row_offset_;
     Updater<T>* updater_;
-    std::vector<T> storage_;
+    std::vector<T, StorageAllocator<T>> storage_;
 
     // following attibutes are used by sparse update
     bool is_sparse_;
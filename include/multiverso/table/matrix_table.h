@@ -4,9 +4,13 @@
 
 #include "multiverso/multiverso.h"
 #include "multiverso/table_interface.h"
+#include "multiverso/table/row_index.h"
+#include "multiverso/table/row_partitioner.h"
+#include "multiverso/util/storage_allocator.h"
 
-#include <vector>
+#include <algorithm>
 #include <random>
+#include <vector>
 
 namespace multiverso {
 
@@ -18,7 +22,8 @@ class MatrixWorkerTable : public WorkerTable {
 public:
   explicit MatrixWorkerTable(const MatrixTableOption<T>& option);
 
-  MatrixWorkerTable(integer_t num_row, integer_t num_col);
+  MatrixWorkerTable(integer_t num_row, integer_t num_col,
+                    RowPartition partition = DefaultRowPartition());
 
   ~MatrixWorkerTable();
 
@@ -78,16 +83,23 @@ public:
     MsgType partition_type,
     std::unordered_map<int, std::vector<Blob>>* out) override;
 
-  void ProcessReplyGet(std::vector<Blob>& reply_data) override;
+  void ProcessReplyGet(std::vector<Blob>& reply_data, int msg_id) override;
 
 protected:
-  T** row_index_;
-  int get_reply_count_;                    // number of unprocessed get reply
+  // Start a Get of keys, the rows replied are written where row_index says.
+  // Any number of Gets may be in flight, from any threads
+  int StartGet(Blob keys, RowIndex<T> row_index,
+               const GetOption* option = nullptr);
+  void ProcessDone(int msg_id) override;
+
+  // row indexes of the Gets in flight, by msg id
+  std::unordered_map<int, RowIndex<T>> row_indexes_;
+  std::mutex* row_indexes_mutex_;
   integer_t num_row_;
   integer_t num_col_;
   integer_t row_size_;                           // equals to sizeof(T) * num_col_
-  int num_server_;
-  std::vector<integer_t> server_offsets_;        // row id offset
+  int num_server_;                               // servers holding rows
+  RowPartitioner partitioner_;
 };
 
 template <typename T>
@@ -98,31 +110,54 @@ class MatrixServerTable : public ServerTable {
 public:
   explicit MatrixServerTable(const MatrixTableOption<T>& option);
 
-  MatrixServerTable(integer_t num_row, integer_t num_col);
-  MatrixServerTable(integer_t num_row, integer_t num_col, float min_value, float max_value);
+  MatrixServerTable(integer_t num_row, integer_t num_col,
+                    RowPartition partition = DefaultRowPartition());
+  MatrixServerTable(integer_t num_row, integer_t num_col, float min_value, float max_value,
+                    RowPartition partition = DefaultRowPartition());
 
   void ProcessAdd(const std::vector<Blob>& data) override;
+  // With a linear updater, the deltas of each row are summed and the rows
+  // updated once each, in order
+  void ProcessAdds(const std::vector<const std::vector<Blob>*>& adds) override;
 
   void ProcessGet(const std::vector<Blob>& data,
                   std::vector<Blob>* result) override;
 
+  // Shards are ranges of the rows of this server
+  bool Sharded() const override { return true; }
+  void PrepareGet(const std::vector<Blob>& data,
+                  std::vector<Blob>* result) override;
+  void GetShard(const std::vector<Blob>& data, std::vector<Blob>* result,
+                int shard, int num_shards) override;
+  void AddShard(const std::vector<const std::vector<Blob>*>& adds,
+                int shard, int num_shards) override;
+
   void Store(Stream* s) override;
   void Load(Stream* s) override;
 
 protected:
+  // The Add of one msg, for the rows in shard
+  void AddRows(const std::vector<Blob>& data, int shard, int num_shards);
+  // Local rows in a shard of num_shards
+  integer_t ShardRows(int num_shards) const {
+    return std::max<integer_t>(1, (my_num_row_ + num_shards - 1) / num_shards);
+  }
+
   int server_id_;
   integer_t my_num_row_;
   integer_t num_col_;
-  integer_t row_offset_;
+  RowPartitioner partitioner_;
   Updater<T>* updater_;
-  std::vector<T> storage_;
+  std::vector<T, StorageAllocator<T>> storage_;
 };
 
 template <typename T>
 struct MatrixTableOption {
-  MatrixTableOption(integer_t num_row, integer_t num_col):num_row(num_row), num_col(num_col){}
+  MatrixTableOption(integer_t num_row, integer_t num_col):num_row(num_row), num_col(num_col),
+    partition(DefaultRowPartition()) {}
   integer_t num_row;
   integer_t num_col;
+  RowPartition partition;
   DEFINE_TABLE_TYPE(T, MatrixWorkerTable, MatrixServerTable);
 };
 
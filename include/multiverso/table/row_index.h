@@ -0,0 +1,46 @@
+#ifndef MULTIVERSO_TABLE_ROW_INDEX_H_
+#define MULTIVERSO_TABLE_ROW_INDEX_H_
+
+#include <unordered_map>
+
+#include "multiverso/table_interface.h"
+#include "multiverso/util/log.h"
+
+namespace multiverso {
+
+// Where the rows replied to a Get are written, set for each Get in time
+// proportional to the rows it asks for rather than to the table. Each Get in
+// flight has its own
+template <typename T>
+class RowIndex {
+public:
+  explicit RowIndex(integer_t num_col) :
+    num_col_(num_col), whole_table_(nullptr) {}
+
+  // num_rows are to be set
+  void Reserve(size_t num_rows) { rows_.reserve(num_rows); }
+
+  // Every row goes to data, row i at i * num_col
+  void SetWholeTable(T* data) { whole_table_ = data; }
+  void Set(integer_t row_id, T* data) { rows_[row_id] = data; }
+
+  T* whole_table() const { return whole_table_; }
+
+  T* Get(integer_t row_id) const {
+    if (whole_table_ != nullptr) {
+      return whole_table_ + static_cast<size_t>(row_id) * num_col_;
+    }
+    auto it = rows_.find(row_id);
+    CHECK(it != rows_.end());
+    return it->second;
+  }
+
+private:
+  integer_t num_col_;
+  T* whole_table_;
+  std::unordered_map<integer_t, T*> rows_;
+};
+
+}  // namespace multiverso
+
+#endif  // MULTIVERSO_TABLE_ROW_INDEX_H_
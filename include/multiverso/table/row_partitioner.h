@@ -0,0 +1,61 @@
+#ifndef MULTIVERSO_TABLE_ROW_PARTITIONER_H_
+#define MULTIVERSO_TABLE_ROW_PARTITIONER_H_
+
+#include <vector>
+
+#include "multiverso/table_interface.h"
+
+namespace multiverso {
+
+// How the rows of a matrix table are spread over the servers
+enum class RowPartition {
+  // server i holds one range of rows, as many rows each
+  kContiguous,
+  // row r is on server r % the number of servers, rows that are hot
+  // together, like the frequent words at the top of a vocabulary, are
+  // spread evenly
+  kInterleaved,
+  // rows go by a hash of their id
+  kHashed
+};
+
+// By -matrix_partition
+RowPartition DefaultRowPartition();
+
+// Which server holds a row, and where among the rows of that server. Workers
+// and servers of a table build it alike, so they agree on both
+class RowPartitioner {
+public:
+  RowPartitioner(RowPartition mode, integer_t num_row, int num_server);
+
+  RowPartition mode() const { return mode_; }
+  // Servers holding rows, fewer than asked if there are fewer rows
+  int num_server() const { return num_server_; }
+
+  int ServerOf(integer_t row) const;
+  // 0 for servers holding no rows
+  integer_t NumRows(int server) const;
+  // Index of row among the rows of its server, the physical row there
+  integer_t LocalRow(integer_t row) const;
+  // Row at physical row local of server
+  integer_t GlobalRow(int server, integer_t local) const;
+
+  // Whether the rows of each server are one range, which starts at
+  // Offset(server)
+  bool contiguous() const { return mode_ == RowPartition::kContiguous; }
+  integer_t Offset(int server) const { return offsets_[server]; }
+
+private:
+  RowPartition mode_;
+  integer_t num_row_;
+  int num_server_;
+  // contiguous: first row of each server, and num_row at the end
+  std::vector<integer_t> offsets_;
+  // hashed: rows of each server, and the local row of each row
+  std::vector<std::vector<integer_t>> rows_;
+  std::vector<integer_t> local_rows_;
+};
+
+}  // namespace multiverso
+
+#endif  // MULTIVERSO_TABLE_ROW_PARTITIONER_H_
@@ -19,7 +19,6 @@ class SparseMatrixWorkerTable : public MatrixWorkerTable<T> {
     int Partition(const std::vector<Blob>& kv,
       MsgType partition_type,
       std::unordered_map<int, std::vector<Blob>>* out) override;
-    void ProcessReplyGet(std::vector<Blob>& reply_data) override;
 
     // get whole table, data is user-allocated memory
     void Get(T* data, size_t size,
@@ -52,17 +51,23 @@ class SparseMatrixServerTable : public MatrixServerTable<T> {
      SparseMatrixServerTable(integer_t num_row, integer_t num_col, bool using_pipeline);
      ~SparseMatrixServerTable();
     void ProcessAdd(const std::vector<Blob>& data) override;
+    // each Add marks rows out of date for other workers, no combining
+    void ProcessAdds(const std::vector<const std::vector<Blob>*>& adds) override {
+      ServerTable::ProcessAdds(adds);
+    }
     void ProcessGet(const std::vector<Blob>& data,
         std::vector<Blob>* result) override;
+    // rows are marked up to date per worker by whole requests
+    bool Sharded() const override { return false; }
  private:
      void UpdateAddState(int worker_id, Blob keys);
      void UpdateGetState(int worker_id, integer_t* keys, size_t key_size,
        std::vector<integer_t>* out_rows);
      integer_t GetLogicalRow(integer_t local_row_id) {
-       return this->row_offset_ + local_row_id;
+       return this->partitioner_.GlobalRow(this->server_id_, local_row_id);
      }
      integer_t GetPhysicalRow(integer_t global_row_id) {
-       return global_row_id - this->row_offset_;
+       return this->partitioner_.LocalRow(global_row_id);
      }
  private:
    bool** up_to_date_;
@@ -1,6 +1,7 @@
 #ifndef MULTIVERSO_TABLE_INTERFACE_H_
 #define MULTIVERSO_TABLE_INTERFACE_H_
 
+#include <functional>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -9,13 +10,12 @@
 #include "multiverso/blob.h"
 #include "multiverso/message.h"
 
-namespace std { class mutex; }
+namespace std { class mutex; class condition_variable; }
 
 namespace multiverso {
 
 typedef int32_t integer_t;
 
-class Waiter;
 struct AddOption;
 struct GetOption;
 enum MsgType;
@@ -29,10 +29,29 @@ public:
   void Get(Blob keys, const GetOption* option = nullptr);
   void Add(Blob keys, Blob values, const AddOption* option = nullptr);
 
+  // Return the id of the op, by which it is waited for. At most
+  // -table_async_slots ops are in flight, a new one waits for the oldest
   int GetAsync(Blob keys, const GetOption* option = nullptr);
   int AddAsync(Blob keys, Blob values, const AddOption* option = nullptr);
 
+  // Run on the worker actor thread once an op is done. It should be short,
+  // and may start other async ops but not wait for any
+  using Callback = std::function<void()>;
+  int GetAsync(Blob keys, const GetOption* option, const Callback& done);
+  int AddAsync(Blob keys, Blob values, const AddOption* option,
+               const Callback& done);
+  // Run done once op id is done, right here if it already is. For ops
+  // started by the typed Async calls of derived tables
+  void Then(int id, const Callback& done);
+
+  // Block until op id is done
   void Wait(int id);
+  // Return whether op id is done, without blocking
+  bool TryWait(int id);
+  // Block until one of the ops is done, return its index in ids
+  int WaitAny(const std::vector<int>& ids);
+  // Block until all the ops are done
+  void WaitAll(const std::vector<int>& ids);
 
   void Reset(int msg_id, int num_wait);
 
@@ -42,17 +61,54 @@ public:
    MsgType partition_type,
    std::unordered_map<int, std::vector<Blob> >* out) = 0;
 
-  virtual void ProcessReplyGet(std::vector<Blob>&) = 0;
+  virtual void ProcessReplyGet(std::vector<Blob>&);
+  // Tables keeping state for each Get in flight override this one instead
+  virtual void ProcessReplyGet(std::vector<Blob>& reply_data, int) {
+    ProcessReplyGet(reply_data);
+  }
+
+  int table_id() const { return table_id_; }
 
   // add user defined data structure
+protected:
+  // Take a slot for a new op, return its id. Derived tables may set up what
+  // they keep for the op by its id before sending it
+  int NewOp(const Callback& done);
+  void SendGet(int id, Blob keys, const GetOption* option);
+  void SendAdd(int id, Blob keys, Blob values, const AddOption* option);
+  // Run on the worker actor thread once op msg_id is done, before the waits
+  // for it return, under the lock of the table
+  virtual void ProcessDone(int) {}
+
 private:
+  // Completion of an async op. Op id takes slot id % the number of slots,
+  // once the op there before is done. Ops started by a callback while that
+  // op is in flight take a slot in overflow_ instead
+  struct Slot {
+    int msg_id;    // -1 if not used yet
+    int num_wait;  // replies still to come
+    Callback done;
+  };
+  // Count a reply of op id, or set the count if reset, then wake up the
+  // waits and run the callback once the op is done
+  void Count(int id, int num_wait, bool reset);
+  // Whether op id is done, under m_. An op whose slot was taken again, or
+  // that left overflow_, is done
+  bool Done(int id);
+  // Slot of op id, nullptr if it was taken again, under m_
+  Slot* Find(int id);
+
   std::string table_name_;
   // assuming there are at most 2^32 tables
   int table_id_;
   std::mutex* m_;
-  std::vector<Waiter*> waitings_;
-  // assuming there are at most 2^32 msgs waiting in line
+  std::condition_variable* done_;
+  std::vector<Slot> slots_;
+  std::unordered_map<int, Slot> overflow_;
+  // id of the next op. Ids wrap around at id_period_, a multiple of the
+  // number of slots below 2^31, so op id keeps slot id % the slots
   int msg_id_;
+  int id_period_;
 };
 
 class Stream;
@@ -70,8 +126,30 @@ public:
   ServerTable();
   virtual ~ServerTable() = default;
   virtual void ProcessAdd(const std::vector<Blob>& data) = 0;
+  // Apply the Adds of several msgs as if one by one in order. Tables may
+  // override it to sum the deltas of the same keys first
+  virtual void ProcessAdds(const std::vector<const std::vector<Blob>*>& adds) {
+    for (auto data : adds) ProcessAdd(*data);
+  }
   virtual void ProcessGet(const std::vector<Blob>& data,
                           std::vector<Blob>* result) = 0;
+
+  // Tables whose rows may be updated by several threads at once return true,
+  // and implement the shard methods below. With -server_threads above 1,
+  // their rows are split into one range for each server thread, and every
+  // thread executes each request for the rows of its range, in order
+  virtual bool Sharded() const { return false; }
+  // Make the result of a Get, of the right size, for GetShard to fill in.
+  // It may run while shards execute other requests
+  virtual void PrepareGet(const std::vector<Blob>& data,
+                          std::vector<Blob>* result) {}
+  // Fill in the rows of a prepared Get result that are in shard
+  virtual void GetShard(const std::vector<Blob>& data,
+                        std::vector<Blob>* result,
+                        int shard, int num_shards) {}
+  // ProcessAdds for the rows in shard
+  virtual void AddShard(const std::vector<const std::vector<Blob>*>& adds,
+                        int shard, int num_shards) {}
 };
 
 #define DEFINE_TABLE_TYPE(template_type,                    \
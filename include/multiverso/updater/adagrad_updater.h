@@ -2,9 +2,10 @@
 #define MULTIVERSO_UPDATER_ADAGRAD_UPDATER_H_
 
 #include "multiverso/updater/updater.h"
+#include "multiverso/updater/updater_kernels.h"
+#include "multiverso/updater/updater_state.h"
 #include "multiverso/util/log.h"
 
-#include <vector>
 #include <cmath>
 #include <cstdint>
 
@@ -14,30 +15,20 @@ namespace multiverso {
 template <typename T>
 class AdaGradUpdater : public Updater<T> {
 public:
-  explicit AdaGradUpdater(size_t size):
-    e(1e-6f), size_(size) {  
-    historic_g_sqr_.resize(MV_NumWorkers(), std::vector<T>(size_));
-    Log::Debug("[AdaGradUpdater] Init with size = %d, e = %f. historic_size = %d\n", size_, e, historic_g_sqr_.size());
+  explicit AdaGradUpdater(size_t size, size_t row_size = 0):
+    historic_g_sqr_(size, row_size), e(1e-6f), size_(size) {  
+    Log::Debug("[AdaGradUpdater] Init with size = %d, e = %f.\n", size_, e);
   }
 
   void Update(size_t num_element, T* data, T* delta, 
               AddOption* option, size_t offset) override {
-
-    auto g_sqr_data_ = historic_g_sqr_.at(option->worker_id());
-    for (size_t index = 0; index < num_element; ++index) {
-      g_sqr_data_[index + offset] -=
-        delta[index] * delta[index] / option->learning_rate() / 
-        option->learning_rate();
-
-      //[TODO(qiwye)] sqrt take too much time
-      data[index + offset] -= option->rho() /
-        std::sqrt(g_sqr_data_[index + offset] + e) *
-        delta[index] / option->learning_rate();
-
-      //data[index + offset] -= option->rho() *
-      //  QuakeRsqrt(g_sqr_data_[index + offset] + e) *
-      //  delta[index] / option->learning_rate();
-    }
+    // the squared gradients of all workers sum up in one history
+    float lr = option->learning_rate(), rho = option->rho(), eps = e;
+    historic_g_sqr_.ForEach(num_element, offset,
+      [=](T* g_sqr, size_t index, size_t n) {
+      kernels::AdaGrad(n, data + offset + index, g_sqr, delta + index,
+                       lr, rho, eps);
+    });
   }
 
 
@@ -53,7 +44,7 @@ private:
   }
 
 protected:
-    std::vector< std::vector<T>> historic_g_sqr_;
+    UpdaterState<T> historic_g_sqr_;
     float e;
     size_t size_;
 };
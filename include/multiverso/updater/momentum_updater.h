@@ -2,31 +2,32 @@
 #define MULTIVERSO_UPDATER_MOMENTUM_UPDATER_H_
 
 #include "updater.h"
-#include <vector>
+#include "updater_kernels.h"
+#include "updater_state.h"
 
 namespace multiverso {
 
 template <typename T>
 class MomentumUpdater : public Updater<T> {
 public:
-  explicit MomentumUpdater(size_t size) : size_(size) {
+  explicit MomentumUpdater(size_t size, size_t row_size = 0) :
+    smooth_gradient_(size, row_size), size_(size) {
     Log::Debug("[SmoothGradientUpdater] Init with size = %d. \n", size_);
-    smooth_gradient_.resize(size_);
   }
 
   void Update(size_t num_element, T* data, T* delta, 
               AddOption* option, size_t offset) override {
-    for (size_t index = 0; index < num_element; ++index) {
-      smooth_gradient_[index + offset] = 
-        option->momentum() * smooth_gradient_[index + offset] 
-        + (1 - option->momentum()) * delta[index];
-      data[index + offset] -= smooth_gradient_[index + offset];
-    }
+    float momentum = option->momentum();
+    smooth_gradient_.ForEach(num_element, offset,
+      [=](T* smooth, size_t index, size_t n) {
+      kernels::Momentum(n, data + offset + index, smooth, delta + index,
+                        momentum);
+    });
   }
 
-  ~MomentumUpdater() { smooth_gradient_.clear(); }
+  ~MomentumUpdater() {}
 protected:
-  std::vector<T> smooth_gradient_;
+  UpdaterState<T> smooth_gradient_;
   size_t size_;
 };
 
@@ -2,6 +2,8 @@
 #define MULTIVERSO_UPDATER_SGD_UPDATER_H_
 
 #include "updater.h"
+#include "updater_kernels.h"
+#include "multiverso/util/log.h"
 
 namespace multiverso {
 
@@ -13,9 +15,13 @@ public:
   }
   void Update(size_t num_element, T* data, T* delta,
               AddOption*, size_t offset) override {
-    for (size_t index = 0; index < num_element; ++index) {
-      data[index + offset] -= delta[index];
-    }
+    kernels::Sub(num_element, data + offset, delta);
+  }
+
+  void UpdateRows(const size_t* row_offsets, int count, size_t num_col,
+                  T* data, T* delta, AddOption*) override {
+    this->UpdateRowsWith(kernels::Sub, row_offsets, count, num_col,
+                         data, delta);
   }
 
   void Access(size_t num_element, T* data, T* blob_data,
@@ -23,6 +29,8 @@ public:
     memcpy(blob_data, data + offset, sizeof(T) * num_element);
   }
 
+  bool Linear() const override { return true; }
+
   ~SGDUpdater(){}
 };
 
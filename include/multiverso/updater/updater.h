@@ -3,6 +3,7 @@
 
 #include <cstring>
 #include <sstream>
+#include <typeinfo>
 #include <multiverso/multiverso.h>
 
 namespace multiverso {
@@ -123,12 +124,32 @@ public:
   virtual void Update(size_t num_element, T* data, T* delta, 
                       AddOption* option = nullptr, size_t offset = 0);
 
+  // Update count rows of num_col elements at once, as
+  // for i in range(0, count):
+  //    Update(num_col, data, delta + i * num_col, option, row_offsets[i])
+  // Derived updaters without their own do exactly that
+  virtual void UpdateRows(const size_t* row_offsets, int count,
+                          size_t num_col, T* data, T* delta,
+                          AddOption* option = nullptr);
+
   // The updater will access the data to out_data in following way 
   //   Get data[offset : offset + num_element) to blob_data[0 : num_element)
   virtual void Access(size_t num_element, T* data, T* blob_data,
                       size_t offset = 0, AddOption* option = nullptr);
-  // Factory method to get the updater
-  static Updater<T>* GetUpdater(size_t size = 0);
+  // Whether an Update with the sum of deltas is the same as Updates with
+  // each of them, whatever their options, so that deltas of the same
+  // element may be summed first. Derived updaters say so themselves
+  virtual bool Linear() const { return typeid(*this) == typeid(Updater<T>); }
+  // Factory method to get the updater, of a table of size elements in rows
+  // of row_size, 0 if it has no rows
+  static Updater<T>* GetUpdater(size_t size = 0, size_t row_size = 0);
+
+protected:
+  // UpdateRows with kernel(num_col, row, delta of row) on each row, in one
+  // openMP region
+  void UpdateRowsWith(void (*kernel)(size_t, T*, const T*),
+                      const size_t* row_offsets, int count, size_t num_col,
+                      T* data, const T* delta);
 };
 
 #define MV_INSTANTIATE_CLASS_WITH_REAL_TYPE(classname) \
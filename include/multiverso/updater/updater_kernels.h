@@ -0,0 +1,80 @@
+#ifndef MULTIVERSO_UPDATER_UPDATER_KERNELS_H_
+#define MULTIVERSO_UPDATER_UPDATER_KERNELS_H_
+
+#include <cmath>
+#include <cstddef>
+#include <string>
+
+namespace multiverso {
+
+// Element loops of the built-in updaters. The float and double ones run on
+// the widest instruction set of the CPU, AVX-512 or AVX2, picked the first
+// time a kernel is called, or as set by -updater_simd. Other types take the
+// scalar loops here
+namespace kernels {
+
+// Instruction set of the float and double kernels: avx512, avx2 or scalar
+std::string Isa();
+// Use the kernels of isa, or the best one of the CPU for auto. Return false,
+// keeping the ones in use, if the CPU or the build does not support isa
+bool SetIsa(const std::string& isa);
+
+// data += delta
+void Add(size_t n, float* data, const float* delta);
+void Add(size_t n, double* data, const double* delta);
+// data -= delta
+void Sub(size_t n, float* data, const float* delta);
+void Sub(size_t n, double* data, const double* delta);
+// smooth = momentum * smooth + (1 - momentum) * delta, data -= smooth
+void Momentum(size_t n, float* data, float* smooth, const float* delta,
+              float momentum);
+void Momentum(size_t n, double* data, double* smooth, const double* delta,
+              float momentum);
+// g_sqr += delta^2 / lr^2, data -= rho / sqrt(g_sqr + e) * delta / lr
+void AdaGrad(size_t n, float* data, float* g_sqr, const float* delta,
+             float lr, float rho, float e);
+void AdaGrad(size_t n, double* data, double* g_sqr, const double* delta,
+             float lr, float rho, float e);
+
+// Hint the cache to load the first lines of the bytes at p
+inline void Prefetch(const void* p, size_t bytes) {
+#if defined(__GNUC__)
+  const char* line = static_cast<const char*>(p);
+  for (size_t i = 0; i < bytes && i < 256; i += 64) {
+    __builtin_prefetch(line + i);
+  }
+#endif
+}
+
+template <typename T>
+void Add(size_t n, T* data, const T* delta) {
+  for (size_t i = 0; i < n; ++i) data[i] += delta[i];
+}
+
+template <typename T>
+void Sub(size_t n, T* data, const T* delta) {
+  for (size_t i = 0; i < n; ++i) data[i] -= delta[i];
+}
+
+template <typename T>
+void Momentum(size_t n, T* data, T* smooth, const T* delta, float momentum) {
+  for (size_t i = 0; i < n; ++i) {
+    smooth[i] = momentum * smooth[i] + (1 - momentum) * delta[i];
+    data[i] -= smooth[i];
+  }
+}
+
+template <typename T>
+void AdaGrad(size_t n, T* data, T* g_sqr, const T* delta,
+             float lr, float rho, float e) {
+  for (size_t i = 0; i < n; ++i) {
+    g_sqr[i] += delta[i] * delta[i] / lr / lr;
+    data[i] -= rho / std::sqrt(g_sqr[i] + e) * delta[i] / lr;
+  }
+}
+
+}  // namespace kernels
+
+}  // namespace multiverso
+
+#endif  // MULTIVERSO_UPDATER_UPDATER_KERNELS_H_
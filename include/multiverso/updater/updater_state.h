@@ -0,0 +1,80 @@
+#ifndef MULTIVERSO_UPDATER_UPDATER_STATE_H_
+#define MULTIVERSO_UPDATER_UPDATER_STATE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+#include "multiverso/util/log.h"
+
+namespace multiverso {
+
+// Optimizer state of an updater, one T for each element of the table,
+// shared by all workers. It is kept in blocks of whole rows, allocated
+// zeroed the first time an Update touches them, so rows never updated
+// take no memory. Threads may update different elements at once
+template <typename T>
+class UpdaterState {
+public:
+  // row_size 0 for tables without rows
+  UpdaterState(size_t size, size_t row_size) : size_(size) {
+    const size_t kMinBlock = 256;
+    block_size_ = row_size == 0 ? 16 * kMinBlock :
+      (kMinBlock + row_size - 1) / row_size * row_size;
+    num_blocks_ = (size + block_size_ - 1) / block_size_;
+    blocks_.reset(new std::atomic<T*>[num_blocks_]());
+  }
+
+  ~UpdaterState() {
+    for (size_t i = 0; i < num_blocks_; ++i) delete[] blocks_[i].load();
+  }
+
+  // Call f(state, index, n) for each run of n elements from offset + index
+  // that lies in one block, state pointing at the first of them
+  template <typename Function>
+  void ForEach(size_t num_element, size_t offset, Function f) {
+    CHECK(offset + num_element <= size_);
+    size_t index = 0;
+    while (index < num_element) {
+      size_t block = (offset + index) / block_size_;
+      size_t begin = (offset + index) % block_size_;
+      size_t n = std::min(num_element - index, block_size_ - begin);
+      f(Block(block) + begin, index, n);
+      index += n;
+    }
+  }
+
+  // Elements allocated so far
+  size_t allocated() const {
+    size_t count = 0;
+    for (size_t i = 0; i < num_blocks_; ++i) {
+      if (blocks_[i].load() != nullptr) count += block_size_;
+    }
+    return count;
+  }
+
+private:
+  // The block, allocated by the first thread to get here
+  T* Block(size_t block) {
+    T* data = blocks_[block].load(std::memory_order_acquire);
+    if (data == nullptr) {
+      T* fresh = new T[block_size_]();
+      if (blocks_[block].compare_exchange_strong(data, fresh)) {
+        data = fresh;
+      } else {
+        delete[] fresh;
+      }
+    }
+    return data;
+  }
+
+  size_t size_;
+  size_t block_size_;
+  size_t num_blocks_;
+  std::unique_ptr<std::atomic<T*>[]> blocks_;
+};
+
+}  // namespace multiverso
+
+#endif  // MULTIVERSO_UPDATER_UPDATER_STATE_H_
@@ -2,7 +2,10 @@
 #define MULTIVERSO_ALLOCATOR_H_
 
 #include <atomic>
-#include <unordered_map>
+#include <cstddef>
+#include <string>
+
+#include "multiverso/dashboard.h"
 
 namespace std { class mutex; }
 
@@ -11,15 +14,41 @@ namespace multiverso {
 const size_t g_pointer_size = sizeof(void*);
 
 class MemoryBlock;
+class SmartAllocator;
+// Free blocks of one size. Pop and Push go through the cache of the calling
+// thread, which takes blocks from and gives them back to the list in batches
 class FreeList {
 public:
-  FreeList(size_t size);
+  FreeList(size_t size, int size_class, SmartAllocator* owner);
   ~FreeList();
   char *Pop();
   void Push(MemoryBlock*);
+  // Link up to n blocks to head, a new one if the list is empty, return the
+  // number of blocks
+  int PopBatch(int n, MemoryBlock** head);
+  // Take back n linked blocks from head to tail
+  void PushBatch(MemoryBlock* head, MemoryBlock* tail, int n);
+  // Free the blocks left in the list since the last call
+  void TrimIdle();
+  // Free all blocks in the list
+  void Trim();
+  // Bytes in the list, of all blocks made for it, and the most of that
+  void GetBytes(long long* free, long long* total, long long* peak) const;
+  size_t size() const { return size_; }
+  int size_class() const { return size_class_; }
 private:
+  // Free up to n blocks from the bottom of the list, the least recently used
+  void FreeBlocks(int n);
+
   MemoryBlock* free_ = nullptr;
   size_t size_;
+  int size_class_;
+  SmartAllocator* owner_;
+  int free_count_;
+  // fewest blocks in the list since the last TrimIdle
+  int min_free_count_;
+  long long total_count_;
+  long long peak_count_;
   std::mutex* mutex_;
 };
 
@@ -28,6 +57,7 @@ public:
   MemoryBlock(size_t size, FreeList* list);
   ~MemoryBlock();
   char* data();
+  FreeList* list() const { return *(FreeList**)data_; }
   void Unlink();
   void Link();
   MemoryBlock* next;
@@ -43,11 +73,23 @@ public:
   virtual char* Alloc(size_t size);
   virtual void Free(char* data);
   virtual void Refer(char *data);
+  // Give memory kept for reuse back to the system
+  virtual void Trim() {}
   static Allocator* Get();
 private:
   static const int header_size_ = sizeof(std::atomic<int>*);
 };
 
+// Shows the bytes of each size class of a SmartAllocator in Dashboard
+class AllocatorMonitor : public Monitor {
+public:
+  explicit AllocatorMonitor(SmartAllocator* allocator);
+  ~AllocatorMonitor();
+  std::string info_string() const override;
+private:
+  SmartAllocator* allocator_;
+};
+
 class SmartAllocator : public Allocator {
 public:
   SmartAllocator();
@@ -55,9 +97,37 @@ public:
   char* Alloc(size_t size);
   void Free(char* data);
   void Refer(char *data);
+  // Free the blocks in the free lists and in the cache of this thread.
+  // Caches of other threads are left alone
+  void Trim() override;
+
+  // Bytes of a size class: in use, kept free in the lists and thread caches,
+  // taken from the system, and the most ever taken
+  struct Stats {
+    long long live;
+    long long cached;
+    long long total;
+    long long peak;
+  };
+  void GetStats(int size_class, Stats* stats) const;
+
+  // Blocks are rounded up to powers of 2, from 2^5 bytes
+  static const int kNumSizeClasses = 64;
+  static const int kMinSizeClass = 5;
 private:
-  std::unordered_map<size_t, FreeList*> pools_;
+  friend class FreeList;
+
+  FreeList* GetFreeList(int size_class);
+  // Trim the idle blocks of all lists every -allocator_trim_sec seconds
+  void TrimIfDue();
+
+  // free lists by log2 of the block size, created once and never moved
+  std::atomic<FreeList*> pools_[kNumSizeClasses];
   std::mutex* mutex_;
+  // bytes in all free lists, capped by -allocator_cache_mb
+  std::atomic<long long> cached_bytes_;
+  std::atomic<long long> next_trim_ms_;
+  AllocatorMonitor* monitor_;
 };
 
 } // namespace multiverso
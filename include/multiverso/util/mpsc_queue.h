@@ -0,0 +1,339 @@
+/*! \brief Defines a lock free queue of many producers and one consumer */
+
+#ifndef MULTIVERSO_MPSC_QUEUE_H_
+#define MULTIVERSO_MPSC_QUEUE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace multiverso {
+/*!
+ * \brief A queue any thread pushes to without locks and only one thread pops
+ *        from. Producers push onto a stack, the consumer takes the whole
+ *        stack at once and reverses it into its own list. A producer only
+ *        locks to wake the consumer up, when the consumer is parked.
+ *        Nodes are recycled through a cache of each thread, and passed in
+ *        batches through a depot shared by the queues of T, since the
+ *        consumer frees the nodes producers take
+ */
+template<typename T>
+class MpscQueue {
+public:
+  /*! \brief Constructor */
+  MpscQueue() : head_(nullptr), front_(nullptr), size_(0),
+                parked_(false), exit_(false) {}
+  ~MpscQueue();
+
+  /*!
+   * \brief Push an element into the queue, from any thread. After you
+   *        pushed, the item would be an uninitialized variable.
+   * \param item item to be pushed
+   */
+  void Push(T& item);
+
+  /*!
+   * \brief Pop an element from the queue, if the queue is empty, the
+   *        consumer would be blocked
+   * \return true when pop successfully; false when the queue is exited
+   */
+  bool Pop(T& result);
+
+  /*!
+   * \brief Pop all elements in the queue into result, blocked until there
+   *        is at least one. Elements are appended in the order pushed
+   * \return true when pop successfully; false when the queue is exited
+   */
+  bool PopBatch(std::vector<T>* result);
+
+  /*! \brief thread will not be blocked. Return false if queue is empty */
+  bool TryPop(T& result);
+
+  /*!
+   * \brief Pop an element from the queue, wait at most timeout_us
+   *        microseconds if the queue is empty
+   * \return true when pop successfully; false on timeout or when the
+   *         queue is exited
+   */
+  bool TimedPop(T& result, long long timeout_us);
+
+  /*! \brief Number of elements in the queue, from any thread */
+  int Size() const { return size_.load(); }
+
+  /*! \brief Whether queue is empty or not, from any thread */
+  bool Empty() const { return size_.load() == 0; }
+
+  /*! \brief Exit queue, awake the consumer if parked */
+  void Exit();
+
+  bool Alive() const { return !exit_.load(); }
+
+private:
+  struct Node {
+    T item;
+    Node* next;
+  };
+
+  // Free nodes of a thread, given to and taken from the depot kBatchSize
+  // at a time
+  class NodeCache {
+  public:
+    ~NodeCache();
+    Node* Alloc();
+    void Free(Node* node);
+    // nullptr once the cache of the thread is gone
+    static NodeCache* Get();
+  private:
+    static bool& destroyed() {
+      thread_local bool destroyed = false;
+      return destroyed;
+    }
+    void GiveBatch();
+    std::vector<Node*> free_;
+  };
+
+  class NodeDepot {
+  public:
+    // never destroyed, threads may return nodes during exit
+    static NodeDepot* Get() {
+      static NodeDepot* depot = new NodeDepot();
+      return depot;
+    }
+    bool Take(std::vector<Node*>* batch);
+    void Give(std::vector<Node*>* batch);
+  private:
+    std::mutex mutex_;
+    std::vector<std::vector<Node*>> batches_;
+  };
+
+  static const size_t kBatchSize = 64;
+  // max number of batches the depot keeps, the rest are freed
+  static const size_t kMaxDepotBatches = 256;
+
+  static Node* NewNode();
+  static void DeleteNode(Node* node);
+
+  // Move the pushed elements to front_ in order, return false if none
+  bool Take();
+  // Park until something is pushed, the queue exits, or the deadline
+  void Park(const std::chrono::steady_clock::time_point* deadline);
+  void PopFront(T& result);
+
+  /*! top of the stack producers push onto */
+  std::atomic<Node*> head_;
+  /*! elements taken by the consumer, oldest first */
+  Node* front_;
+  std::atomic<int> size_;
+  std::atomic<bool> parked_;
+  std::atomic<bool> exit_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+
+  // No copying allowed
+  MpscQueue(const MpscQueue&);
+  void operator=(const MpscQueue&);
+};
+
+template<typename T>
+const size_t MpscQueue<T>::kBatchSize;
+template<typename T>
+const size_t MpscQueue<T>::kMaxDepotBatches;
+
+template<typename T>
+MpscQueue<T>::NodeCache::~NodeCache() {
+  while (!free_.empty()) GiveBatch();
+  destroyed() = true;
+}
+
+template<typename T>
+typename MpscQueue<T>::Node* MpscQueue<T>::NodeCache::Alloc() {
+  if (free_.empty()) {
+    std::vector<Node*> batch;
+    if (!NodeDepot::Get()->Take(&batch)) return new Node();
+    free_.swap(batch);
+  }
+  Node* node = free_.back();
+  free_.pop_back();
+  return node;
+}
+
+template<typename T>
+void MpscQueue<T>::NodeCache::Free(Node* node) {
+  free_.push_back(node);
+  if (free_.size() >= 2 * kBatchSize) GiveBatch();
+}
+
+template<typename T>
+typename MpscQueue<T>::NodeCache* MpscQueue<T>::NodeCache::Get() {
+  if (destroyed()) return nullptr;
+  thread_local NodeCache cache;
+  return &cache;
+}
+
+template<typename T>
+void MpscQueue<T>::NodeCache::GiveBatch() {
+  size_t n = std::min(kBatchSize, free_.size());
+  std::vector<Node*> batch(free_.end() - n, free_.end());
+  free_.resize(free_.size() - n);
+  NodeDepot::Get()->Give(&batch);
+}
+
+template<typename T>
+bool MpscQueue<T>::NodeDepot::Take(std::vector<Node*>* batch) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (batches_.empty()) return false;
+  batch->swap(batches_.back());
+  batches_.pop_back();
+  return true;
+}
+
+template<typename T>
+void MpscQueue<T>::NodeDepot::Give(std::vector<Node*>* batch) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (batches_.size() < kMaxDepotBatches) {
+      batches_.push_back(std::vector<Node*>());
+      batches_.back().swap(*batch);
+      return;
+    }
+  }
+  for (auto node : *batch) delete node;
+  batch->clear();
+}
+
+template<typename T>
+typename MpscQueue<T>::Node* MpscQueue<T>::NewNode() {
+  NodeCache* cache = NodeCache::Get();
+  return cache != nullptr ? cache->Alloc() : new Node();
+}
+
+template<typename T>
+void MpscQueue<T>::DeleteNode(Node* node) {
+  // release what the item holds now, keep the node
+  node->item = T();
+  NodeCache* cache = NodeCache::Get();
+  if (cache != nullptr) {
+    cache->Free(node);
+  } else {
+    delete node;
+  }
+}
+
+template<typename T>
+MpscQueue<T>::~MpscQueue() {
+  Take();
+  while (front_ != nullptr) {
+    Node* node = front_;
+    front_ = node->next;
+    DeleteNode(node);
+  }
+}
+
+template<typename T>
+void MpscQueue<T>::Push(T& item) {
+  Node* node = NewNode();
+  node->item = std::move(item);
+  node->next = head_.load(std::memory_order_relaxed);
+  size_.fetch_add(1);
+  while (!head_.compare_exchange_weak(node->next, node)) {}
+  // pairs with parked_ stored before the consumer checks head_ again
+  if (parked_.load()) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    condition_.notify_one();
+  }
+}
+
+template<typename T>
+bool MpscQueue<T>::Take() {
+  if (front_ != nullptr) return true;
+  Node* node = head_.exchange(nullptr, std::memory_order_acquire);
+  while (node != nullptr) {
+    Node* next = node->next;
+    node->next = front_;
+    front_ = node;
+    node = next;
+  }
+  return front_ != nullptr;
+}
+
+template<typename T>
+void MpscQueue<T>::Park(
+    const std::chrono::steady_clock::time_point* deadline) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  parked_.store(true);
+  auto ready = [this]{ return head_.load() != nullptr || exit_.load(); };
+  if (deadline == nullptr) {
+    condition_.wait(lock, ready);
+  } else {
+    condition_.wait_until(lock, *deadline, ready);
+  }
+  parked_.store(false, std::memory_order_relaxed);
+}
+
+template<typename T>
+void MpscQueue<T>::PopFront(T& result) {
+  Node* node = front_;
+  front_ = node->next;
+  result = std::move(node->item);
+  DeleteNode(node);
+  size_.fetch_sub(1);
+}
+
+template<typename T>
+bool MpscQueue<T>::Pop(T& result) {
+  while (!Take()) {
+    if (exit_.load()) return false;
+    Park(nullptr);
+  }
+  PopFront(result);
+  return true;
+}
+
+template<typename T>
+bool MpscQueue<T>::PopBatch(std::vector<T>* result) {
+  while (!Take()) {
+    if (exit_.load()) return false;
+    Park(nullptr);
+  }
+  while (front_ != nullptr) {
+    result->emplace_back();
+    PopFront(result->back());
+  }
+  return true;
+}
+
+template<typename T>
+bool MpscQueue<T>::TryPop(T& result) {
+  if (!Take()) return false;
+  PopFront(result);
+  return true;
+}
+
+template<typename T>
+bool MpscQueue<T>::TimedPop(T& result, long long timeout_us) {
+  auto deadline = std::chrono::steady_clock::now() +
+    std::chrono::microseconds(timeout_us);
+  while (!Take()) {
+    if (exit_.load() || std::chrono::steady_clock::now() >= deadline) {
+      return false;
+    }
+    Park(&deadline);
+  }
+  PopFront(result);
+  return true;
+}
+
+template<typename T>
+void MpscQueue<T>::Exit() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  exit_.store(true);
+  condition_.notify_all();
+}
+
+}  // namespace multiverso
+
+#endif  // MULTIVERSO_MPSC_QUEUE_H_
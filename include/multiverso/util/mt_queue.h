@@ -4,6 +4,7 @@
 #define MULTIVERSO_MT_QUEUE_H_
 
 #include <atomic>
+#include <chrono>
 #include <queue>
 #include <mutex>
 #include <condition_variable>
@@ -40,6 +41,14 @@ public:
   /*! \brief thread will not be blocked. Return false if queue is empty */
   bool TryPop(T& result);
 
+  /*!
+   * \brief Pop an element from the queue, wait at most timeout_us
+   *        microseconds if the queue is empty
+   * \return true when pop successfully; false on timeout or when the
+   *         queue is exited
+   */
+  bool TimedPop(T& result, long long timeout_us);
+
   /*!
    * \brief Get the front element from the queue, if the queue is empty,
    *        threat who call front would be blocked. Not move semantics.
@@ -109,6 +118,21 @@ bool MtQueue<T>::TryPop(T& result) {
   return true;
 }
 
+template<typename T>
+bool MtQueue<T>::TimedPop(T& result, long long timeout_us) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto deadline = std::chrono::steady_clock::now() +
+    std::chrono::microseconds(timeout_us);
+  while (buffer_.empty() && !exit_) {
+    if (empty_condition_.wait_until(lock, deadline) ==
+        std::cv_status::timeout) break;
+  }
+  if (buffer_.empty()) return false;
+  result = std::move(buffer_.front());
+  buffer_.pop();
+  return true;
+}
+
 template<typename T>
 bool MtQueue<T>::Front(T& result) {
   std::unique_lock<std::mutex> lock(mutex_);
@@ -3,12 +3,17 @@
 
 #include <string>
 #include <unordered_set>
+#include <vector>
 
 namespace multiverso {
 namespace net {
 
 void GetLocalIPAddress(std::unordered_set<std::string>* result);
 
+// Read the machine file, one "ip" or "ip:port" entry per rank
+void ParseMachineFile(const std::string& filename,
+                      std::vector<std::string>* result);
+
 }  // namespace net
 }  // namespace multiverso
 
@@ -0,0 +1,71 @@
+#ifndef MULTIVERSO_UTIL_STORAGE_ALLOCATOR_H_
+#define MULTIVERSO_UTIL_STORAGE_ALLOCATOR_H_
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+namespace multiverso {
+
+// Memory of server table storage. It comes zeroed and untouched, so pages
+// are placed on the NUMA node of the thread that first uses them, the server
+// thread, unless -server_numa_node binds them. With -server_storage=hugepage
+// blocks from 2MB are backed by huge pages, explicit ones if the system has
+// them reserved, transparent ones otherwise
+namespace storage {
+
+// Whether -server_storage asks for huge pages
+bool UseHugePages();
+void* Allocate(size_t bytes, bool huge_pages);
+void Free(void* data, size_t bytes, bool huge_pages);
+
+}  // namespace storage
+
+template <typename T>
+class StorageAllocator {
+public:
+  typedef T value_type;
+
+  StorageAllocator() : huge_pages_(storage::UseHugePages()) {}
+  template <typename U>
+  StorageAllocator(const StorageAllocator<U>& other) :
+    huge_pages_(other.huge_pages()) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(storage::Allocate(n * sizeof(T), huge_pages_));
+  }
+  void deallocate(T* data, size_t n) {
+    storage::Free(data, n * sizeof(T), huge_pages_);
+  }
+
+  // Elements are default rather than value initialized, the memory is
+  // already zeroed and writing it would touch every page here. Storage that
+  // shrinks and grows again keeps its old values
+  template <typename U>
+  void construct(U* p) { ::new (static_cast<void*>(p)) U; }
+  template <typename U, typename... Args>
+  void construct(U* p, Args&&... args) {
+    ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+  }
+
+  bool huge_pages() const { return huge_pages_; }
+
+private:
+  bool huge_pages_;
+};
+
+template <typename T, typename U>
+bool operator==(const StorageAllocator<T>& lhs,
+                const StorageAllocator<U>& rhs) {
+  return lhs.huge_pages() == rhs.huge_pages();
+}
+
+template <typename T, typename U>
+bool operator!=(const StorageAllocator<T>& lhs,
+                const StorageAllocator<U>& rhs) {
+  return !(lhs == rhs);
+}
+
+}  // namespace multiverso
+
+#endif  // MULTIVERSO_UTIL_STORAGE_ALLOCATOR_H_
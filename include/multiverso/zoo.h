@@ -12,6 +12,7 @@
 namespace multiverso {
 
 class NetInterface;
+template<typename T> class MtQueue;
 
 //  Zoo Manage all components in the system, include all actors, and network
 //  Maintain system information, provide method to access this information
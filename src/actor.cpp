@@ -3,16 +3,17 @@
 #include <chrono>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "multiverso/message.h"
 #include "multiverso/util/log.h"
-#include "multiverso/util/mt_queue.h"
+#include "multiverso/util/mpsc_queue.h"
 #include "multiverso/zoo.h"
 
 namespace multiverso {
 
 Actor::Actor(const std::string& name) : name_(name) {
-  mailbox_.reset(new MtQueue<MessagePtr>());
+  mailbox_.reset(new MpscQueue<MessagePtr>());
   Zoo::Get()->RegisterActor(name, this);
   is_working_ = false;
 }
@@ -37,8 +38,16 @@ void Actor::Receive(MessagePtr& msg) { mailbox_->Push(msg); }
 
 void Actor::Main() {
   is_working_ = true;
-  MessagePtr msg;
-  while (mailbox_->Pop(msg)) {
+  // all msgs waiting are handled per wake up
+  std::vector<MessagePtr> msgs;
+  while (mailbox_->PopBatch(&msgs)) {
+    ProcessBatch(msgs);
+    msgs.clear();
+  }
+}
+
+void Actor::ProcessBatch(std::vector<MessagePtr>& msgs) {
+  for (MessagePtr& msg : msgs) {
     if (handlers_.find(msg->type()) != handlers_.end()) {
       handlers_[msg->type()](msg);
     } else if (handlers_.find(MsgType::Default) != handlers_.end()) {
@@ -1,47 +1,109 @@
 #include "multiverso/blob.h"
 
+#include <atomic>
+
 #include "multiverso/util/allocator.h"
 #include "multiverso/util/log.h"
 
 namespace multiverso {
 
-Blob::Blob(size_t size) : size_(size) {
+struct Blob::External {
+  std::atomic<int> ref;
+  FreeFunc free_func;
+  void* data;
+  void* hint;
+};
+
+Blob::Blob(size_t size) : size_(size), external_(nullptr) {
   CHECK(size > 0);
   data_ = Allocator::Get()->Alloc(size);
+  memory_ = data_;
 }
 
 // Construct from external memory. Will copy a new piece
-Blob::Blob(const void* data, size_t size) : size_(size) {
+Blob::Blob(const void* data, size_t size) : size_(size), external_(nullptr) {
   data_ = Allocator::Get()->Alloc(size);
+  memory_ = data_;
   memcpy(data_, data, size_);
 }
 
-Blob::Blob(void* data, size_t size) : size_(size) {
+Blob::Blob(void* data, size_t size) : size_(size), external_(nullptr) {
   data_ = Allocator::Get()->Alloc(size);
+  memory_ = data_;
   memcpy(data_, data, size_);
 }
 
+Blob::Blob(void* data, size_t size, FreeFunc free_func, void* hint) :
+  data_(static_cast<char*>(data)), size_(size), memory_(nullptr) {
+  CHECK_NOTNULL(free_func);
+  external_ = new External();
+  external_->ref = 1;
+  external_->free_func = free_func;
+  external_->data = data;
+  external_->hint = hint;
+}
+
+Blob Blob::Wrap(void* data, size_t size) {
+  Blob blob;
+  blob.data_ = static_cast<char*>(data);
+  blob.size_ = size;
+  return blob;
+}
+
+Blob::Blob(const Blob& rhs, size_t offset, size_t size) : size_(size) {
+  CHECK(offset + size <= rhs.size_);
+  memory_ = rhs.memory_;
+  external_ = rhs.external_;
+  data_ = rhs.data_ + offset;
+  Refer();
+}
+
 Blob::Blob(const Blob& rhs) {
-  if (rhs.size() != 0) {
-    Allocator::Get()->Refer(rhs.data_);
-  }
   this->data_ = rhs.data_;
   this->size_ = rhs.size_;
+  this->memory_ = rhs.memory_;
+  this->external_ = rhs.external_;
+  Refer();
 }
 
 Blob::~Blob() {
-  if (data_ != nullptr) {
-    Allocator::Get()->Free(data_);
-  }
+  Release();
 }
 
 // Shallow copy by default. Call \ref CopyFrom for a deep copy
 void Blob::operator=(const Blob& rhs) {
-  if (rhs.size() != 0) {
-    Allocator::Get()->Refer(rhs.data_);
-  }
+  // copy first, rhs may share memory with this
+  Blob copy(rhs);
+  Release();
   this->data_ = rhs.data_;
   this->size_ = rhs.size_;
+  this->memory_ = rhs.memory_;
+  this->external_ = rhs.external_;
+  Refer();
+}
+
+void Blob::CopyFrom(const Blob& src) {
+  Blob copy(src.data_, src.size_);
+  *this = copy;
+}
+
+void Blob::Refer() {
+  if (memory_ != nullptr) {
+    Allocator::Get()->Refer(memory_);
+  }
+  if (external_ != nullptr) {
+    ++external_->ref;
+  }
+}
+
+void Blob::Release() {
+  if (memory_ != nullptr) {
+    Allocator::Get()->Free(memory_);
+  }
+  if (external_ != nullptr && --external_->ref == 0) {
+    external_->free_func(external_->data, external_->hint);
+    delete external_;
+  }
 }
 
 }  // namespace multiverso
@@ -0,0 +1,346 @@
+#include "multiverso/codec.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "multiverso/util/configure.h"
+#include "multiverso/util/log.h"
+
+namespace multiverso {
+
+MV_DEFINE_int(wire_codec, 0, "codecs of table msgs: 1 integer_t keys, "
+              "2 size_t keys, 4 compressed values, or a sum of them");
+
+namespace codec {
+
+namespace {
+
+// Codec of blob i, 2 bits at 2 * i of the codec header
+enum BlobCodec { kRaw = 0, kVarint32 = 1, kVarint64 = 2, kLZ = 3 };
+const size_t kMaxCodedBlobs = 16;
+
+// smaller blobs are sent as they are
+const size_t kMinKeysSize = 64;
+const size_t kMinCompressSize = 1024;
+// bytes compressed first to tell if a blob is worth compressing
+const size_t kSampleSize = 4096;
+
+const int kHashBits = 14;
+const size_t kMinMatch = 4;
+const size_t kMaxOffset = 65535;
+
+// codecs + 1 of each table, 0 for the tables not set. Read on every msg, so
+// without a lock
+const int kMaxTables = 1024;
+std::atomic<int> table_codecs[kMaxTables];
+
+uint64_t ZigZag(int64_t v) {
+  return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+int64_t UnZigZag(uint64_t v) {
+  return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+uint32_t Load32(const char* p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+size_t Hash(uint32_t v) {
+  return (v * 2654435761u) >> (32 - kHashBits);
+}
+
+// Sequences as in LZ4: a token with the literal and match lengths in its
+// nibbles, more length bytes when a nibble is 15, the literals, then the
+// 2 byte offset of the match. The last sequence only has literals
+class LZWriter {
+public:
+  LZWriter(char* dst, size_t capacity) :
+    dst_(dst), capacity_(capacity), size_(0) {}
+
+  // match is 0 for the last sequence, return false once out of room
+  bool Sequence(const char* literals, size_t num_literals,
+                size_t offset, size_t match) {
+    size_t match_code = match == 0 ? 0 : match - kMinMatch;
+    if (!Put(static_cast<char>((std::min<size_t>(num_literals, 15) << 4) |
+                               std::min<size_t>(match_code, 15)))) {
+      return false;
+    }
+    if (num_literals >= 15 && !PutLength(num_literals - 15)) return false;
+    if (capacity_ - size_ < num_literals) return false;
+    memcpy(dst_ + size_, literals, num_literals);
+    size_ += num_literals;
+    if (match == 0) return true;
+    if (!Put(static_cast<char>(offset & 0xff)) ||
+        !Put(static_cast<char>(offset >> 8))) {
+      return false;
+    }
+    return match_code < 15 || PutLength(match_code - 15);
+  }
+
+  size_t size() const { return size_; }
+
+private:
+  bool Put(char c) {
+    if (size_ == capacity_) return false;
+    dst_[size_++] = c;
+    return true;
+  }
+
+  bool PutLength(size_t length) {
+    for (; length >= 255; length -= 255) {
+      if (!Put(static_cast<char>(255))) return false;
+    }
+    return Put(static_cast<char>(length));
+  }
+
+  char* dst_;
+  size_t capacity_;
+  size_t size_;
+};
+
+// Return the compressed size, 0 if it is over capacity
+size_t CompressTo(const char* src, size_t size, char* dst, size_t capacity) {
+  // positions + 1 of the last 4 bytes seen with each hash
+  thread_local std::vector<uint32_t> table;
+  table.assign(static_cast<size_t>(1) << kHashBits, 0);
+  LZWriter writer(dst, capacity);
+  size_t anchor = 0;
+  size_t i = 0;
+  while (i + kMinMatch <= size) {
+    uint32_t v = Load32(src + i);
+    uint32_t& slot = table[Hash(v)];
+    size_t candidate = slot;
+    slot = static_cast<uint32_t>(i + 1);
+    if (candidate > 0 && i - (candidate - 1) <= kMaxOffset &&
+        Load32(src + candidate - 1) == v) {
+      size_t match_pos = candidate - 1;
+      size_t length = kMinMatch;
+      while (i + length < size && src[match_pos + length] == src[i + length]) {
+        ++length;
+      }
+      if (!writer.Sequence(src + anchor, i - anchor, i - match_pos, length)) {
+        return 0;
+      }
+      i += length;
+      anchor = i;
+    } else {
+      // skip faster through data that does not match
+      i += 1 + ((i - anchor) >> 6);
+    }
+  }
+  if (!writer.Sequence(src + anchor, size - anchor, 0, 0)) return 0;
+  return writer.size();
+}
+
+}  // namespace
+
+void SetTableCodec(int table_id, int codecs) {
+  CHECK(table_id >= 0 && table_id < kMaxTables);
+  CHECK(codecs >= 0);
+  table_codecs[table_id].store(codecs + 1, std::memory_order_release);
+}
+
+int GetTableCodec(int table_id) {
+  if (table_id >= 0 && table_id < kMaxTables) {
+    int codecs = table_codecs[table_id].load(std::memory_order_acquire);
+    if (codecs > 0) return codecs - 1;
+  }
+  return MV_CONFIG_wire_codec;
+}
+
+void Encode(Message* msg) {
+  switch (msg->type()) {
+  case MsgType::Request_Get:
+  case MsgType::Request_Add:
+  case MsgType::Reply_Get:
+    break;
+  default:
+    return;
+  }
+  int codecs = GetTableCodec(msg->table_id());
+  if (codecs == kNone) return;
+  std::vector<Blob>& data = msg->data();
+  int mask = 0;
+  for (size_t i = 0; i < data.size() && i < kMaxCodedBlobs; ++i) {
+    Blob encoded;
+    int blob_codec = kRaw;
+    if (i == 0) {
+      if ((codecs & kKeys32) &&
+          EncodeKeys(data[i], sizeof(int32_t), &encoded)) {
+        blob_codec = kVarint32;
+      } else if ((codecs & kKeys64) &&
+                 EncodeKeys(data[i], sizeof(int64_t), &encoded)) {
+        blob_codec = kVarint64;
+      }
+    } else if ((codecs & kValuesLZ) && Compress(data[i], &encoded)) {
+      blob_codec = kLZ;
+    }
+    if (blob_codec != kRaw) {
+      data[i] = encoded;
+      mask |= blob_codec << (2 * i);
+    }
+  }
+  msg->set_codec(mask);
+}
+
+void Decode(Message* msg) {
+  int mask = msg->codec();
+  if (mask == 0) return;
+  std::vector<Blob>& data = msg->data();
+  for (size_t i = 0; i < data.size() && i < kMaxCodedBlobs; ++i) {
+    switch ((mask >> (2 * i)) & 3) {
+    case kVarint32: data[i] = DecodeKeys(data[i], sizeof(int32_t)); break;
+    case kVarint64: data[i] = DecodeKeys(data[i], sizeof(int64_t)); break;
+    case kLZ: data[i] = Decompress(data[i]); break;
+    default: break;
+    }
+  }
+  msg->set_codec(0);
+}
+
+// An encoded blob starts with the size of the blob
+bool EncodeKeys(const Blob& keys, size_t key_size, Blob* out) {
+  CHECK(key_size == sizeof(int32_t) || key_size == sizeof(int64_t));
+  size_t size = keys.size();
+  if (size < kMinKeysSize || size % key_size != 0) return false;
+  // worth it from a quarter saved
+  size_t budget = sizeof(size_t) + size - size / 4;
+  Blob encoded(budget + 10);  // room for the varint crossing the budget
+  char* p = encoded.data();
+  memcpy(p, &size, sizeof(size_t));
+  size_t pos = sizeof(size_t);
+  uint64_t prev = 0;
+  for (size_t i = 0; i < size; i += key_size) {
+    uint64_t key;
+    int64_t delta;
+    if (key_size == sizeof(int32_t)) {
+      uint32_t key32;
+      memcpy(&key32, keys.data() + i, sizeof(key32));
+      delta = static_cast<int32_t>(key32 - static_cast<uint32_t>(prev));
+      key = key32;
+    } else {
+      memcpy(&key, keys.data() + i, sizeof(key));
+      delta = static_cast<int64_t>(key - prev);
+    }
+    prev = key;
+    uint64_t v = ZigZag(delta);
+    while (v >= 0x80) {
+      p[pos++] = static_cast<char>(v | 0x80);
+      v >>= 7;
+    }
+    p[pos++] = static_cast<char>(v);
+    if (pos > budget) return false;
+  }
+  *out = Blob(encoded, 0, pos);
+  return true;
+}
+
+Blob DecodeKeys(const Blob& encoded, size_t key_size) {
+  CHECK(encoded.size() >= sizeof(size_t));
+  size_t size;
+  memcpy(&size, encoded.data(), sizeof(size_t));
+  CHECK(size % key_size == 0);
+  Blob keys(size);
+  const unsigned char* p =
+    reinterpret_cast<const unsigned char*>(encoded.data()) + sizeof(size_t);
+  const unsigned char* end =
+    reinterpret_cast<const unsigned char*>(encoded.data()) + encoded.size();
+  uint64_t prev = 0;
+  for (size_t i = 0; i < size; i += key_size) {
+    uint64_t v = 0;
+    for (int shift = 0; ; shift += 7) {
+      CHECK(p < end && shift < 64);
+      v |= static_cast<uint64_t>(*p & 0x7f) << shift;
+      if ((*p++ & 0x80) == 0) break;
+    }
+    prev += static_cast<uint64_t>(UnZigZag(v));
+    if (key_size == sizeof(int32_t)) {
+      uint32_t key32 = static_cast<uint32_t>(prev);
+      memcpy(keys.data() + i, &key32, sizeof(key32));
+      prev = key32;
+    } else {
+      memcpy(keys.data() + i, &prev, sizeof(prev));
+    }
+  }
+  CHECK(p == end);
+  return keys;
+}
+
+bool Compress(const Blob& blob, Blob* out) {
+  size_t size = blob.size();
+  if (size < kMinCompressSize || size > 0xffffffffu) return false;
+  // worth it from an eighth saved, most values do not compress at all
+  size_t sample = std::min(size, kSampleSize);
+  std::vector<char> sample_out(sample);
+  if (CompressTo(blob.data(), sample, sample_out.data(),
+                 sample - sample / 8) == 0) {
+    return false;
+  }
+  size_t capacity = size - size / 8;
+  Blob compressed(sizeof(size_t) + capacity);
+  memcpy(compressed.data(), &size, sizeof(size_t));
+  size_t compressed_size = CompressTo(blob.data(), size,
+    compressed.data() + sizeof(size_t), capacity);
+  if (compressed_size == 0) return false;
+  *out = Blob(compressed, 0, sizeof(size_t) + compressed_size);
+  return true;
+}
+
+Blob Decompress(const Blob& compressed) {
+  CHECK(compressed.size() >= sizeof(size_t));
+  size_t size;
+  memcpy(&size, compressed.data(), sizeof(size_t));
+  Blob blob(size);
+  char* out = blob.data();
+  size_t pos = 0;
+  const unsigned char* p =
+    reinterpret_cast<const unsigned char*>(compressed.data()) + sizeof(size_t);
+  const unsigned char* end =
+    reinterpret_cast<const unsigned char*>(compressed.data()) +
+    compressed.size();
+  auto length = [&p, end](size_t nibble) {
+    if (nibble == 15) {
+      unsigned char more;
+      do {
+        CHECK(p < end);
+        more = *p++;
+        nibble += more;
+      } while (more == 255);
+    }
+    return nibble;
+  };
+  while (p < end) {
+    unsigned char token = *p++;
+    size_t num_literals = length(token >> 4);
+    CHECK(num_literals <= static_cast<size_t>(end - p) &&
+          num_literals <= size - pos);
+    memcpy(out + pos, p, num_literals);
+    p += num_literals;
+    pos += num_literals;
+    if (p == end) break;
+    CHECK(end - p >= 2);
+    size_t offset = p[0] | (static_cast<size_t>(p[1]) << 8);
+    p += 2;
+    size_t match = length(token & 15) + kMinMatch;
+    CHECK(offset > 0 && offset <= pos && match <= size - pos);
+    if (offset >= match) {
+      memcpy(out + pos, out + pos - offset, match);
+    } else {
+      // the match overlaps what it writes
+      for (size_t i = 0; i < match; ++i) out[pos + i] = out[pos + i - offset];
+    }
+    pos += match;
+  }
+  CHECK(pos == size);
+  return blob;
+}
+
+}  // namespace codec
+
+}  // namespace multiverso
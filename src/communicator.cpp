@@ -1,15 +1,108 @@
 #include "multiverso/communicator.h"
 
+#include <algorithm>
+#include <atomic>
 #include <memory>
+#include <sstream>
 #include <thread>
 
+#include "multiverso/codec.h"
+#include "multiverso/dashboard.h"
 #include "multiverso/zoo.h"
 #include "multiverso/net.h"
+#include "multiverso/util/configure.h"
 #include "multiverso/util/log.h"
-#include "multiverso/util/mt_queue.h"
+#include "multiverso/util/mpsc_queue.h"
 
 namespace multiverso {
 
+MV_DEFINE_int(comm_batch_size, 0, "max bytes of small msgs to a rank packed "
+              "into one msg, 0 to send every msg on its own");
+MV_DEFINE_int(comm_batch_us, 100, "max microseconds a small msg waits "
+              "for others to be packed with");
+MV_DEFINE_int(comm_spin_us, 50, "microseconds the communicator keeps "
+              "polling after the last msg before it parks");
+MV_DEFINE_int(comm_park_us, 1000, "max microseconds the communicator parks "
+              "between polls, 0 to never park");
+MV_DEFINE_int(comm_recv_park_us, 20, "max microseconds the communicator "
+              "parks on a net it polls for received msgs, as those msgs "
+              "don't end the park");
+
+class PollMonitor : public Monitor {
+public:
+  PollMonitor() : Monitor("COMMUNICATOR_POLL"),
+    busy_us(0), spin_us(0), park_us(0) {}
+  ~PollMonitor() { Dashboard::RemoveMonitor(name()); }
+
+  std::string info_string() const override {
+    std::ostringstream oss;
+    oss << "[" << name() << "] "
+        << " busy = " << busy_us / 1000.0 << "ms"
+        << " spin = " << spin_us / 1000.0 << "ms"
+        << " park = " << park_us / 1000.0 << "ms";
+    return oss.str();
+  }
+
+  std::atomic<long long> busy_us;
+  std::atomic<long long> spin_us;
+  std::atomic<long long> park_us;
+};
+
+namespace {
+
+// Paces a polling loop. It polls back to back while there are msgs and for
+// -comm_spin_us after the last one, then parks between polls for times
+// doubling from 1us up to -comm_park_us
+class Backoff {
+public:
+  explicit Backoff(PollMonitor* monitor) : monitor_(monitor),
+    last_(Clock::now()), idle_since_(last_), park_us_(0) {}
+
+  // Account the poll since the last call, return microseconds to park
+  // before the next poll, 0 to poll again at once
+  long long Polled(bool got_msg) {
+    Clock::time_point now = Clock::now();
+    long long elapsed = Micros(now - last_);
+    last_ = now;
+    if (got_msg) {
+      monitor_->busy_us += elapsed;
+      idle_since_ = now;
+      park_us_ = 0;
+      return 0;
+    }
+    monitor_->spin_us += elapsed;
+    if (Micros(now - idle_since_) < MV_CONFIG_comm_spin_us) return 0;
+    park_us_ = std::min<long long>(park_us_ > 0 ? park_us_ * 2 : 1,
+                                   MV_CONFIG_comm_park_us);
+    return park_us_;
+  }
+
+  // Account the park since Polled, woken if a msg ended it
+  void Parked(bool woken) {
+    Clock::time_point now = Clock::now();
+    monitor_->park_us += Micros(now - last_);
+    last_ = now;
+    if (woken) {
+      idle_since_ = now;
+      park_us_ = 0;
+    }
+  }
+
+private:
+  typedef std::chrono::steady_clock Clock;
+  static long long Micros(Clock::duration duration) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+      duration).count();
+  }
+
+  PollMonitor* monitor_;
+  Clock::time_point last_;
+  Clock::time_point idle_since_;
+  long long park_us_;
+};
+
+}  // namespace
+
 namespace message {
 
 bool to_server(MsgType type) {
@@ -26,39 +119,86 @@ bool to_controler(MsgType type) {
   return (static_cast<int>(type)) > 32;
 }
 
+size_t bytes(const MessagePtr& msg) {
+  size_t size = Message::kHeaderSize;
+  for (auto& blob : msg->data()) size += blob.size();
+  return size;
+}
+
+// Only table requests and replies are packed, control msgs are sent at once
+bool batchable(const MessagePtr& msg) {
+  switch (msg->type()) {
+  case MsgType::Request_Get:
+  case MsgType::Request_Add:
+  case MsgType::Reply_Get:
+  case MsgType::Reply_Add:
+    break;
+  default:
+    return false;
+  }
+  return bytes(msg) < static_cast<size_t>(MV_CONFIG_comm_batch_size);
+}
+
 }  // namespace message
 
+// For each packed msg, its header and number of blobs
+const int kBatchMetaSize = Message::kHeaderSize / sizeof(int) + 1;
+
 Communicator::Communicator() : Actor(actor::kCommunicator) {
   RegisterHandler(MsgType::Default, std::bind(
     &Communicator::ProcessMessage, this, std::placeholders::_1));
   net_util_ = NetInterface::Get();
+  poll_monitor_.reset(new PollMonitor());
 }
 
 Communicator::~Communicator() { }
 
 void Communicator::Main() {
   is_working_ = true;
+  batches_.resize(net_util_->size());
 
   switch (net_util_->thread_level_support()) {
   case NetThreadLevel::THREAD_MULTIPLE: {
     recv_thread_.reset(new std::thread(&Communicator::Communicate, this));
-    Actor::Main();
+    if (MV_CONFIG_comm_batch_size > 0) {
+      BatchMain();
+    } else {
+      Actor::Main();
+    }
     recv_thread_->join();
     break;
   }
   case NetThreadLevel::THREAD_SERIALIZED: {
     MessagePtr msg;
+    Backoff backoff(poll_monitor_.get());
     while (mailbox_->Alive()) {
+      bool got_msg = false;
       // Try pop and Send
       if (mailbox_->TryPop(msg)) {
         ProcessMessage(msg);
+        got_msg = true;
       }
+      long long wait_us = FlushExpired();
       // Probe and Recv
       size_t size = net_util_->Recv(&msg);
-      if (size > 0) LocalForward(msg);
+      if (size > 0) {
+        LocalForward(msg);
+        got_msg = true;
+      }
       CHECK(msg.get() == nullptr);
-      net_util_->Send(msg);
+      net_util_->SendPending();
+      long long park_us = backoff.Polled(got_msg);
+      // msgs still sending move on only in Send calls
+      if (park_us > 0 && !net_util_->Sending()) {
+        if (wait_us >= 0) park_us = std::min(park_us, wait_us);
+        // a msg to send ends the park, a msg received does not
+        park_us = std::min<long long>(park_us, MV_CONFIG_comm_recv_park_us);
+        bool woken = mailbox_->TimedPop(msg, park_us);
+        backoff.Parked(woken);
+        if (woken) ProcessMessage(msg);
+      }
     }
+    FlushAll();
     break;
   }
   default:
@@ -66,32 +206,154 @@ void Communicator::Main() {
   }
 }
 
+void Communicator::BatchMain() {
+  MessagePtr msg;
+  while (true) {
+    long long wait_us = FlushExpired();
+    bool popped = wait_us < 0 ? mailbox_->Pop(msg)
+                              : mailbox_->TimedPop(msg, wait_us);
+    if (popped) {
+      ProcessMessage(msg);
+    } else if (!mailbox_->Alive()) {
+      break;
+    }
+  }
+  FlushAll();
+}
+
 void Communicator::ProcessMessage(MessagePtr& msg) {
   if (msg->dst() != net_util_->rank()) {
-    net_util_->Send(msg);
+    codec::Encode(msg.get());
+    if (MV_CONFIG_comm_batch_size > 0) {
+      SendBatched(msg);
+    } else {
+      net_util_->Send(msg);
+    }
     return;
   }
   LocalForward(msg);
 }
 
+void Communicator::SendBatched(MessagePtr& msg) {
+  int dst = msg->dst();
+  if (!message::batchable(msg)) {
+    // keep the order of msgs to dst
+    Flush(dst);
+    net_util_->Send(msg);
+    return;
+  }
+  PendingBatch& batch = batches_[dst];
+  if (batch.msgs.empty()) {
+    batch.bytes = 0;
+    batch.deadline = Clock::now() +
+      std::chrono::microseconds(MV_CONFIG_comm_batch_us);
+  }
+  batch.bytes += message::bytes(msg);
+  batch.msgs.push_back(std::move(msg));
+  if (batch.bytes >= static_cast<size_t>(MV_CONFIG_comm_batch_size)) {
+    Flush(dst);
+  }
+}
+
+void Communicator::Flush(int dst) {
+  std::vector<MessagePtr>& msgs = batches_[dst].msgs;
+  if (msgs.empty()) return;
+  if (msgs.size() == 1) {
+    net_util_->Send(msgs[0]);
+    msgs.clear();
+    return;
+  }
+  MessagePtr batch = Pack(&msgs);
+  batch->set_src(net_util_->rank());
+  batch->set_dst(dst);
+  net_util_->Send(batch);
+}
+
+MessagePtr Communicator::Pack(std::vector<MessagePtr>* msgs) {
+  MessagePtr batch(Message::Create());
+  batch->set_type(MsgType::Comm_Batch);
+  Blob meta(msgs->size() * kBatchMetaSize * sizeof(int));
+  batch->Push(meta);
+  int* p = reinterpret_cast<int*>(meta.data());
+  for (auto& msg : *msgs) {
+    memcpy(p, msg->header(), Message::kHeaderSize);
+    p[kBatchMetaSize - 1] = static_cast<int>(msg->size());
+    p += kBatchMetaSize;
+    for (auto& blob : msg->data()) batch->Push(blob);
+  }
+  msgs->clear();
+  return batch;
+}
+
+long long Communicator::FlushExpired() {
+  long long wait_us = -1;
+  if (MV_CONFIG_comm_batch_size <= 0) return wait_us;
+  Clock::time_point now = Clock::now();
+  for (int dst = 0; dst < static_cast<int>(batches_.size()); ++dst) {
+    PendingBatch& batch = batches_[dst];
+    if (batch.msgs.empty()) continue;
+    if (batch.deadline <= now) {
+      Flush(dst);
+      continue;
+    }
+    long long left = std::chrono::duration_cast<std::chrono::microseconds>(
+      batch.deadline - now).count() + 1;
+    if (wait_us < 0 || left < wait_us) wait_us = left;
+  }
+  return wait_us;
+}
+
+void Communicator::FlushAll() {
+  for (int dst = 0; dst < static_cast<int>(batches_.size()); ++dst) {
+    Flush(dst);
+  }
+}
+
+void Communicator::Unpack(MessagePtr& msg, std::vector<MessagePtr>* msgs) {
+  Blob& meta = msg->data()[0];
+  int num_msgs = static_cast<int>(meta.size<int>() / kBatchMetaSize);
+  const int* p = reinterpret_cast<const int*>(meta.data());
+  size_t next_blob = 1;
+  for (int i = 0; i < num_msgs; ++i, p += kBatchMetaSize) {
+    MessagePtr packed(Message::Create());
+    memcpy(packed->header(), p, Message::kHeaderSize);
+    for (int j = 0; j < p[kBatchMetaSize - 1]; ++j) {
+      packed->Push(msg->data()[next_blob++]);
+    }
+    msgs->push_back(std::move(packed));
+  }
+  CHECK(next_blob == msg->size());
+  msg.reset();
+}
+
 void Communicator::Communicate() {
+  Backoff backoff(poll_monitor_.get());
   while (is_working_) {
-    MessagePtr msg(new Message());
+    MessagePtr msg(Message::Create());
     int size = net_util_->Recv(&msg);
-    if (size == -1) {
-      continue;
-    }
     if (size > 0) {
       // a message received
       CHECK(msg->dst() == Zoo::Get()->rank());
       LocalForward(msg);
     }
+    long long park_us = backoff.Polled(size > 0);
+    if (park_us > 0) {
+      net_util_->WaitRecv(park_us);
+      backoff.Parked(false);
+    }
   }
   Log::Debug("Comm recv thread exit\n");
 }
 
 void Communicator::LocalForward(MessagePtr& msg) {
   CHECK(msg->dst() == Zoo::Get()->rank());
+  if (msg->type() == MsgType::Comm_Batch) {
+    std::vector<MessagePtr> msgs;
+    Unpack(msg, &msgs);
+    for (auto& packed : msgs) LocalForward(packed);
+    return;
+  }
+  codec::Decode(msg.get());
   if (message::to_server(msg->type())) {
     SendTo(actor::kServer, msg);
   } else if (message::to_worker(msg->type())) {
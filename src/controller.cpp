@@ -60,7 +60,7 @@ public:
       count_blob.As<int>(0) = num_worker_;
       count_blob.As<int>(1) = num_server_;
       for (int i = Zoo::Get()->size() - 1; i >= 0; --i) {  // let rank 0 be last
-        MessagePtr reply(new Message());
+        MessagePtr reply(Message::Create());
         reply->set_src(Zoo::Get()->rank());
         reply->set_dst(i);
         reply->set_type(MsgType::Control_Reply_Register);
@@ -0,0 +1,126 @@
+#include "multiverso/message.h"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+namespace multiverso {
+
+namespace {
+
+// Free Messages are cached per thread, and moved in batches of kBatchSize
+// through a global depot, since a msg is often freed by another actor than
+// the one created it
+const size_t kBatchSize = 64;
+// max number of batches the depot keeps, the rest are freed
+const size_t kMaxDepotBatches = 256;
+
+class MessageDepot {
+public:
+  static MessageDepot* Get() {
+    // never destroyed, threads may return msgs during exit
+    static MessageDepot* depot = new MessageDepot();
+    return depot;
+  }
+
+  bool Take(std::vector<Message*>* batch) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (batches_.empty()) return false;
+    batch->swap(batches_.back());
+    batches_.pop_back();
+    return true;
+  }
+
+  void Give(std::vector<Message*>* batch) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (batches_.size() < kMaxDepotBatches) {
+        batches_.push_back(std::vector<Message*>());
+        batches_.back().swap(*batch);
+        return;
+      }
+    }
+    for (auto msg : *batch) delete msg;
+    batch->clear();
+  }
+
+private:
+  std::mutex mutex_;
+  std::vector<std::vector<Message*>> batches_;
+};
+
+// set once the cache of the thread is gone, msgs freed by static
+// destructors are deleted
+thread_local bool message_cache_destroyed = false;
+
+class MessageCache {
+public:
+  ~MessageCache() {
+    while (!free_.empty()) GiveBatch();
+    message_cache_destroyed = true;
+  }
+
+  static MessageCache* Get() {
+    if (message_cache_destroyed) return nullptr;
+    thread_local MessageCache cache;
+    return &cache;
+  }
+
+  Message* Alloc() {
+    if (free_.empty()) {
+      std::vector<Message*> batch;
+      if (!MessageDepot::Get()->Take(&batch)) return new Message();
+      free_.swap(batch);
+    }
+    Message* msg = free_.back();
+    free_.pop_back();
+    return msg;
+  }
+
+  void Free(Message* msg) {
+    // release the blobs now, keep the capacity
+    msg->data().clear();
+    free_.push_back(msg);
+    if (free_.size() >= 2 * kBatchSize) GiveBatch();
+  }
+
+private:
+  void GiveBatch() {
+    size_t n = std::min(kBatchSize, free_.size());
+    std::vector<Message*> batch(free_.end() - n, free_.end());
+    free_.resize(free_.size() - n);
+    MessageDepot::Get()->Give(&batch);
+  }
+
+  std::vector<Message*> free_;
+};
+
+}  // namespace
+
+MessagePtr Message::Create() {
+  MessageCache* cache = MessageCache::Get();
+  MessagePtr msg(cache != nullptr ? cache->Alloc() : new Message());
+  memset(msg->header_, 0, kHeaderSize);
+  return msg;
+}
+
+Message* Message::CreateReplyMessage() {
+  Message* reply = Create().release();
+  reply->set_dst(this->src());
+  reply->set_src(this->dst());
+  reply->set_type(static_cast<MsgType>(-header_[2]));
+  reply->set_table_id(this->table_id());
+  reply->set_msg_id(this->msg_id());
+  return reply;
+}
+
+void MessageDeleter::operator()(Message* msg) const {
+  MessageCache* cache = MessageCache::Get();
+  if (cache != nullptr) {
+    cache->Free(msg);
+  } else {
+    delete msg;
+  }
+}
+
+}  // namespace multiverso
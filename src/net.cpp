@@ -1,26 +1,49 @@
 #include "multiverso/net.h"
 
+#include <algorithm>
+#include <chrono>
 #include <limits>
 #include <mutex>
+#include <thread>
+
 #include "multiverso/message.h"
+#include "multiverso/util/configure.h"
 #include "multiverso/util/log.h"
 
 #include "multiverso/net/zmq_net.h"
 #include "multiverso/net/mpi_net.h"
+#include "multiverso/net/shm_net.h"
+#include "multiverso/net/tcp_net.h"
 
 namespace multiverso {
 
+MV_DECLARE_bool(shm_net);
+MV_DECLARE_int(comm_recv_park_us);
+
 NetInterface* NetInterface::Get() {
 #ifdef MULTIVERSO_USE_ZMQ
-  static ZMQNetWrapper net_impl;
-  return &net_impl;
+  static ZMQNetWrapper base_impl;
+#elif defined(MULTIVERSO_USE_TCP)
+  static TcpNetWrapper base_impl;
 #else
 // #ifdef MULTIVERSO_USE_MPI
   // Use MPI by default
-  static MPINetWrapper net_impl;
-  return &net_impl;
+  static MPINetWrapper base_impl;
 // #endif
 #endif
+#ifndef _WIN32
+  // Decided once, the flags are parsed before the net is inited
+  static NetInterface* net_impl = MV_CONFIG_shm_net ?
+    static_cast<NetInterface*>(new ShmNetWrapper(&base_impl)) : &base_impl;
+  return net_impl;
+#else
+  return &base_impl;
+#endif
+}
+
+void NetInterface::WaitRecv(long long timeout_us) {
+  timeout_us = std::min<long long>(timeout_us, MV_CONFIG_comm_recv_park_us);
+  std::this_thread::sleep_for(std::chrono::microseconds(timeout_us));
 }
 
 namespace net {
@@ -39,6 +62,62 @@ template void Allreduce<int>(int*, size_t);
 template void Allreduce<float>(float*, size_t);
 template void Allreduce<double>(double*, size_t);
 
+namespace {
+const size_t kAlignment = sizeof(size_t);
+const char kPadding[kAlignment] = { 0 };
+
+size_t Padding(size_t size) {
+  return (kAlignment - size % kAlignment) % kAlignment;
+}
+}  // namespace
+
+size_t FrameSegments(MessagePtr& msg, std::vector<size_t>* meta,
+                     std::vector<Segment>* segments) {
+  size_t num_blobs = msg->size();
+  meta->resize(num_blobs + 2);
+  size_t frame_size = Message::kHeaderSize + sizeof(size_t) * (num_blobs + 1);
+  (*meta)[1] = num_blobs;
+  for (size_t i = 0; i < num_blobs; ++i) {
+    size_t blob_size = msg->data()[i].size();
+    (*meta)[i + 2] = blob_size;
+    frame_size += blob_size + Padding(blob_size);
+  }
+  (*meta)[0] = frame_size;
+  segments->clear();
+  segments->emplace_back(reinterpret_cast<char*>(meta->data()),
+                         sizeof(size_t));
+  segments->emplace_back(reinterpret_cast<char*>(msg->header()),
+                         static_cast<size_t>(Message::kHeaderSize));
+  segments->emplace_back(reinterpret_cast<char*>(&(*meta)[1]),
+                         sizeof(size_t) * (num_blobs + 1));
+  for (auto& blob : msg->data()) {
+    if (blob.size() == 0) continue;
+    segments->emplace_back(blob.data(), blob.size());
+    if (Padding(blob.size()) > 0) {
+      segments->emplace_back(kPadding, Padding(blob.size()));
+    }
+  }
+  return frame_size;
+}
+
+void ParseFrame(const Blob& frame, MessagePtr* msg_ptr) {
+  if (!msg_ptr->get()) *msg_ptr = Message::Create();
+  MessagePtr& msg = *msg_ptr;
+  msg->data().clear();
+  char* p = frame.data();
+  memcpy(msg->header(), p, Message::kHeaderSize);
+  size_t num_blobs;
+  memcpy(&num_blobs, p + Message::kHeaderSize, sizeof(size_t));
+  const size_t* blob_sizes = reinterpret_cast<const size_t*>(
+    p + Message::kHeaderSize + sizeof(size_t));
+  size_t offset = Message::kHeaderSize + sizeof(size_t) * (num_blobs + 1);
+  for (size_t i = 0; i < num_blobs; ++i) {
+    msg->Push(Blob(frame, offset, blob_sizes[i]));
+    offset += blob_sizes[i] + Padding(blob_sizes[i]);
+  }
+  CHECK(offset == frame.size());
+}
+
 }  // namespace net
 
 
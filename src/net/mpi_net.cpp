@@ -4,6 +4,9 @@
 
 namespace multiverso {
 
+MV_DEFINE_bool(mpi_zero_copy_send, false, "send blobs in place, without copy");
+MV_DEFINE_int(mpi_send_window, 8, "max number of msgs on the air at once");
+
 template void MPINetWrapper::Allreduce<char>(char*, size_t);
 template void MPINetWrapper::Allreduce<int>(int*, size_t);
 template void MPINetWrapper::Allreduce<float>(float*, size_t);
@@ -0,0 +1,356 @@
+#include "multiverso/net/shm_net.h"
+
+#include "multiverso/util/configure.h"
+
+namespace multiverso {
+
+MV_DEFINE_bool(shm_net, false, "msgs between ranks on the same host go "
+               "through shared memory");
+MV_DEFINE_int(shm_ring_size, 1 << 22, "bytes of the shared memory ring "
+              "from one local rank to another");
+
+}  // namespace multiverso
+
+#ifndef _WIN32
+
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "multiverso/util/log.h"
+
+namespace multiverso {
+
+namespace {
+
+const size_t kHostNameSize = 64;
+
+struct HostRecord {
+  int rank;
+  char host[kHostNameSize];
+};
+
+}  // namespace
+
+// Shared by the two ends of a ring. Positions only grow, the producer moves
+// tail and the consumer moves head, each on its own cache line
+struct ShmRing::Control {
+  std::atomic<unsigned long long> head;
+  char pad0[64 - sizeof(std::atomic<unsigned long long>)];
+  std::atomic<unsigned long long> tail;
+  char pad1[64 - sizeof(std::atomic<unsigned long long>)];
+};
+
+ShmRing::ShmRing() : base_(nullptr), mapped_(0), control_(nullptr),
+  data_(nullptr), capacity_(0) {}
+
+ShmRing::~ShmRing() {
+  if (base_ != nullptr) munmap(base_, mapped_);
+}
+
+void ShmRing::Open(const std::string& name, size_t capacity, bool create) {
+  CHECK(capacity > 0 && (capacity & (capacity - 1)) == 0);
+  name_ = name;
+  capacity_ = capacity;
+  mapped_ = sizeof(Control) + capacity_;
+  int flags = create ? (O_CREAT | O_EXCL | O_RDWR) : O_RDWR;
+  int fd = shm_open(name_.c_str(), flags, 0600);
+  if (fd < 0) Log::Fatal("Failed to open shared memory %s\n", name_.c_str());
+  if (create && ftruncate(fd, mapped_) != 0) {
+    Log::Fatal("Failed to size shared memory %s\n", name_.c_str());
+  }
+  void* addr = mmap(nullptr, mapped_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    Log::Fatal("Failed to map shared memory %s\n", name_.c_str());
+  }
+  base_ = static_cast<char*>(addr);
+  control_ = reinterpret_cast<Control*>(base_);
+  if (create) new (control_) Control();
+  data_ = base_ + sizeof(Control);
+}
+
+void ShmRing::Unlink() {
+  shm_unlink(name_.c_str());
+}
+
+size_t ShmRing::Write(const char* src, size_t size) {
+  unsigned long long tail = control_->tail.load(std::memory_order_relaxed);
+  unsigned long long head = control_->head.load(std::memory_order_acquire);
+  size = std::min(size, static_cast<size_t>(capacity_ - (tail - head)));
+  size_t pos = static_cast<size_t>(tail & (capacity_ - 1));
+  size_t first = std::min(size, capacity_ - pos);
+  memcpy(data_ + pos, src, first);
+  memcpy(data_, src + first, size - first);
+  control_->tail.store(tail + size, std::memory_order_release);
+  return size;
+}
+
+size_t ShmRing::Read(char* dst, size_t size) {
+  unsigned long long head = control_->head.load(std::memory_order_relaxed);
+  unsigned long long tail = control_->tail.load(std::memory_order_acquire);
+  size = std::min(size, static_cast<size_t>(tail - head));
+  size_t pos = static_cast<size_t>(head & (capacity_ - 1));
+  size_t first = std::min(size, capacity_ - pos);
+  memcpy(dst, data_ + pos, first);
+  memcpy(dst + first, data_, size - first);
+  control_->head.store(head + size, std::memory_order_release);
+  return size;
+}
+
+// Msgs are written as frames, see net::FrameSegments
+struct ShmNetWrapper::Outgoing {
+  ShmRing ring;
+  std::deque<MessagePtr> queue;
+  // sizes of the front msg
+  std::vector<size_t> meta;
+  // pieces of the front msg not fully written yet
+  std::vector<net::Segment> segments;
+  size_t segment = 0;
+  size_t offset = 0;
+};
+
+struct ShmNetWrapper::Incoming {
+  ShmRing ring;
+  size_t frame_size = 0;
+  size_t frame_size_read = 0;
+  // the frame, blobs of the msg are views of it
+  Blob frame;
+  size_t frame_read = 0;
+};
+
+ShmNetWrapper::ShmNetWrapper(NetInterface* remote) :
+  remote_(remote), next_local_(0), remote_first_(false) {
+  CHECK_NOTNULL(remote_);
+}
+
+ShmNetWrapper::~ShmNetWrapper() {}
+
+void ShmNetWrapper::Init(int* argc, char** argv) {
+  remote_->Init(argc, argv);
+  ExchangeHosts();
+  OpenRings();
+  Log::Info("%s net inited, rank = %d, size = %d, %d ranks on %s\n",
+    name().c_str(), rank(), size(), static_cast<int>(local_ranks_.size()),
+    hosts_[rank()].c_str());
+}
+
+void ShmNetWrapper::Finalize() {
+  CloseRings();
+  remote_->Finalize();
+}
+
+int ShmNetWrapper::Bind(int rank, char* endpoint) {
+  return remote_->Bind(rank, endpoint);
+}
+
+// Ranks given by Connect are treated as remote
+int ShmNetWrapper::Connect(int* ranks, char* endpoints[], int size) {
+  return remote_->Connect(ranks, endpoints, size);
+}
+
+void ShmNetWrapper::ExchangeHosts() {
+  HostRecord mine;
+  memset(&mine, 0, sizeof(mine));
+  mine.rank = rank();
+  CHECK(gethostname(mine.host, kHostNameSize - 1) == 0);
+
+  std::vector<HostRecord> records(size());
+  long long job_id = 0;
+  if (rank() == 0) {
+    records[0] = mine;
+    for (int i = 1; i < size(); ++i) {
+      HostRecord record;
+      remote_->RecvFrom(i, reinterpret_cast<char*>(&record), sizeof(record));
+      CHECK(record.rank > 0 && record.rank < size());
+      records[record.rank] = record;
+    }
+    job_id = static_cast<long long>(getpid()) << 32 ^
+      std::chrono::system_clock::now().time_since_epoch().count();
+    for (int i = 1; i < size(); ++i) {
+      remote_->SendTo(i, reinterpret_cast<char*>(&job_id), sizeof(job_id));
+      remote_->SendTo(i, reinterpret_cast<char*>(records.data()),
+        static_cast<int>(records.size() * sizeof(HostRecord)));
+    }
+  } else {
+    remote_->SendTo(0, reinterpret_cast<char*>(&mine), sizeof(mine));
+    remote_->RecvFrom(0, reinterpret_cast<char*>(&job_id), sizeof(job_id));
+    remote_->RecvFrom(0, reinterpret_cast<char*>(records.data()),
+      static_cast<int>(records.size() * sizeof(HostRecord)));
+  }
+
+  job_name_ = "/multiverso_" + std::to_string(job_id & 0x7fffffffffffll);
+  hosts_.clear();
+  local_ranks_.clear();
+  for (auto& record : records) {
+    hosts_.push_back(record.host);
+    if (hosts_.back() == mine.host && record.rank != rank()) {
+      local_ranks_.push_back(static_cast<int>(hosts_.size()) - 1);
+    }
+  }
+}
+
+void ShmNetWrapper::Barrier() {
+  int token = 0;
+  if (rank() == 0) {
+    for (int i = 1; i < size(); ++i) {
+      remote_->RecvFrom(i, reinterpret_cast<char*>(&token), sizeof(token));
+    }
+    for (int i = 1; i < size(); ++i) {
+      remote_->SendTo(i, reinterpret_cast<char*>(&token), sizeof(token));
+    }
+  } else {
+    remote_->SendTo(0, reinterpret_cast<char*>(&token), sizeof(token));
+    remote_->RecvFrom(0, reinterpret_cast<char*>(&token), sizeof(token));
+  }
+}
+
+void ShmNetWrapper::OpenRings() {
+  size_t capacity = 1;
+  while (capacity < static_cast<size_t>(MV_CONFIG_shm_ring_size)) {
+    capacity <<= 1;
+  }
+  auto ring_name = [this](int src, int dst) {
+    return job_name_ + "_" + std::to_string(src) + "_" + std::to_string(dst);
+  };
+  outgoing_.clear(); outgoing_.resize(size());
+  incoming_.clear(); incoming_.resize(size());
+  // every rank creates the rings it reads from, then opens the others
+  for (int src : local_ranks_) {
+    incoming_[src].reset(new Incoming());
+    incoming_[src]->ring.Open(ring_name(src, rank()), capacity, true);
+  }
+  Barrier();
+  for (int dst : local_ranks_) {
+    outgoing_[dst].reset(new Outgoing());
+    outgoing_[dst]->ring.Open(ring_name(rank(), dst), capacity, false);
+  }
+  Barrier();
+  // the mappings stay, no name is left behind if a rank dies
+  for (int src : local_ranks_) incoming_[src]->ring.Unlink();
+}
+
+void ShmNetWrapper::CloseRings() {
+  outgoing_.clear();
+  incoming_.clear();
+  local_ranks_.clear();
+}
+
+int ShmNetWrapper::Send(MessagePtr& msg) {
+  if (msg.get() == nullptr) return 0;
+  int dst = msg->dst();
+  if (outgoing_.size() > static_cast<size_t>(dst) && outgoing_[dst]) {
+    outgoing_[dst]->queue.push_back(std::move(msg));
+    return SendLocal(dst);
+  }
+  return remote_->Send(msg);
+}
+
+int ShmNetWrapper::SendPending() {
+  int size = 0;
+  for (int dst : local_ranks_) size += SendLocal(dst);
+  int remote_size = remote_->SendPending();
+  if (remote_size > 0) size += remote_size;
+  return size;
+}
+
+bool ShmNetWrapper::Sending() const {
+  for (int dst : local_ranks_) {
+    if (!outgoing_[dst]->queue.empty()) return true;
+  }
+  return remote_->Sending();
+}
+
+int ShmNetWrapper::SendLocal(int dst) {
+  Outgoing& out = *outgoing_[dst];
+  int size = 0;
+  while (!out.queue.empty()) {
+    MessagePtr& msg = out.queue.front();
+    if (out.segments.empty()) {
+      net::FrameSegments(msg, &out.meta, &out.segments);
+      out.segment = 0;
+      out.offset = 0;
+    }
+    while (out.segment < out.segments.size()) {
+      auto& segment = out.segments[out.segment];
+      size_t written = out.ring.Write(segment.first + out.offset,
+                                      segment.second - out.offset);
+      size += static_cast<int>(written);
+      out.offset += written;
+      if (out.offset < segment.second) return size;  // ring is full
+      ++out.segment;
+      out.offset = 0;
+    }
+    out.segments.clear();
+    out.queue.pop_front();
+  }
+  return size;
+}
+
+int ShmNetWrapper::Recv(MessagePtr* msg) {
+  bool had_msg = msg->get() != nullptr;
+  remote_first_ = !remote_first_;
+  if (remote_first_) {
+    int size = remote_->Recv(msg);
+    if (size > 0) return size;
+  }
+  for (size_t i = 0; i < local_ranks_.size(); ++i) {
+    int src = local_ranks_[next_local_];
+    next_local_ = (next_local_ + 1) % local_ranks_.size();
+    int size = RecvLocal(src, msg);
+    if (size > 0) return size;
+  }
+  if (!remote_first_) {
+    int size = remote_->Recv(msg);
+    if (size > 0) return size;
+  }
+  // the wrapped net may have made a msg for nothing
+  if (!had_msg) msg->reset();
+  return 0;
+}
+
+int ShmNetWrapper::RecvLocal(int src, MessagePtr* msg_ptr) {
+  Incoming& in = *incoming_[src];
+  if (in.frame_size_read < sizeof(size_t)) {
+    in.frame_size_read += in.ring.Read(
+      reinterpret_cast<char*>(&in.frame_size) + in.frame_size_read,
+      sizeof(size_t) - in.frame_size_read);
+    if (in.frame_size_read < sizeof(size_t)) return 0;
+    in.frame = Blob(in.frame_size);
+    in.frame_read = 0;
+  }
+  in.frame_read += in.ring.Read(in.frame.data() + in.frame_read,
+                                in.frame_size - in.frame_read);
+  if (in.frame_read < in.frame_size) return 0;
+
+  net::ParseFrame(in.frame, msg_ptr);
+  int size = static_cast<int>(in.frame_size + sizeof(size_t));
+  in.frame = Blob();
+  in.frame_size_read = 0;
+  return size;
+}
+
+void ShmNetWrapper::SendTo(int rank, char* buf, int len) const {
+  remote_->SendTo(rank, buf, len);
+}
+
+void ShmNetWrapper::RecvFrom(int rank, char* buf, int len) const {
+  remote_->RecvFrom(rank, buf, len);
+}
+
+void ShmNetWrapper::SendRecv(int send_rank, char* send_buf, int send_len,
+  int recv_rank, char* recv_buf, int recv_len) const {
+  remote_->SendRecv(send_rank, send_buf, send_len,
+                    recv_rank, recv_buf, recv_len);
+}
+
+}  // namespace multiverso
+
+#endif  // _WIN32
@@ -0,0 +1,614 @@
+#ifdef MULTIVERSO_USE_TCP
+
+#include "multiverso/net/tcp_net.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "multiverso/util/configure.h"
+#include "multiverso/util/log.h"
+#include "multiverso/util/net_util.h"
+
+namespace multiverso {
+
+MV_DEFINE_string(machine_file, "", "path of machine file");
+MV_DEFINE_int(port, 55555, "port used to communication");
+MV_DEFINE_int(tcp_connections, 1, "number of connections to each peer, the "
+              "msgs of each table go on one of them");
+MV_DECLARE_int(comm_batch_size);
+
+namespace {
+
+const size_t kBufferSize = 1 << 16;
+const int kMaxEvents = 64;
+const int kConnectRetries = 600;
+const int kConnectRetryMs = 100;
+// SendTo and Finalize wait this long at most between tries to write
+const int kWriteRetryMs = 1;
+
+struct Handshake {
+  int rank;
+  int index;
+};
+
+void SplitEndpoint(const std::string& endpoint, std::string* host,
+                   std::string* port) {
+  size_t colon = endpoint.rfind(':');
+  CHECK(colon != std::string::npos);
+  *host = endpoint.substr(0, colon);
+  *port = endpoint.substr(colon + 1);
+}
+
+bool Resolve(const std::string& endpoint, sockaddr_in* addr) {
+  std::string host, port;
+  SplitEndpoint(endpoint, &host, &port);
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* result = nullptr;
+  if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0) {
+    return false;
+  }
+  memcpy(addr, result->ai_addr, sizeof(sockaddr_in));
+  freeaddrinfo(result);
+  return true;
+}
+
+bool IsLocalHost(const std::string& host,
+                 const std::unordered_set<std::string>& local_ip) {
+  return local_ip.count(host) > 0 || host == "localhost" ||
+         host.compare(0, 4, "127.") == 0;
+}
+
+// Write iov from *first on, in as few sendmsg calls as the socket takes,
+// until all is written or the socket is full. Return bytes written
+size_t WriteSome(int fd, std::vector<iovec>* iov, size_t* first) {
+  size_t size = 0;
+  while (*first < iov->size()) {
+    msghdr header;
+    memset(&header, 0, sizeof(header));
+    header.msg_iov = &(*iov)[*first];
+    header.msg_iovlen = std::min(iov->size() - *first,
+                                 static_cast<size_t>(IOV_MAX));
+    ssize_t written = sendmsg(fd, &header, MSG_NOSIGNAL);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+      Log::Fatal("Failed to send on socket %d, errno = %d\n", fd, errno);
+    }
+    size += static_cast<size_t>(written);
+    size_t left = static_cast<size_t>(written);
+    while (*first < iov->size() && left >= (*iov)[*first].iov_len) {
+      left -= (*iov)[*first].iov_len;
+      ++*first;
+    }
+    if (left > 0) {
+      iovec& partial = (*iov)[*first];
+      partial.iov_base = static_cast<char*>(partial.iov_base) + left;
+      partial.iov_len -= left;
+    }
+  }
+  return size;
+}
+
+void ToIovecs(const std::vector<net::Segment>& segments,
+              std::vector<iovec>* iov) {
+  iov->resize(segments.size());
+  for (size_t i = 0; i < segments.size(); ++i) {
+    (*iov)[i].iov_base = const_cast<char*>(segments[i].first);
+    (*iov)[i].iov_len = segments[i].second;
+  }
+}
+
+// Blocking, used for the handshake on a socket just accepted
+void ReadAll(int fd, char* buf, size_t size) {
+  while (size > 0) {
+    ssize_t n = recv(fd, buf, size, 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) Log::Fatal("Failed to read on socket %d\n", fd);
+    buf += n;
+    size -= static_cast<size_t>(n);
+  }
+}
+
+}  // namespace
+
+// A msg, or the data of a SendTo, not fully written yet
+struct TcpNetWrapper::Pending {
+  // keeps what iov points to
+  MessagePtr msg;
+  std::vector<size_t> meta;
+  std::vector<iovec> iov;
+  size_t first = 0;
+  // written only once each connection j to the rank has written fence[j]
+  // entries, empty for a single connection
+  std::vector<unsigned long long> fence;
+};
+
+struct TcpNetWrapper::Outgoing {
+  ~Outgoing() { if (fd >= 0) close(fd); }
+
+  int fd = -1;
+  int rank = -1;
+  // Send and SendTo may be called by different threads, and the queue is
+  // also written by Recv
+  std::mutex mutex;
+  std::deque<Pending> queue;
+  // entries ever queued and fully written, read without the mutex
+  std::atomic<unsigned long long> queued{ 0 };
+  std::atomic<unsigned long long> written{ 0 };
+};
+
+// Msgs are read as frames, see net::FrameSegments. Small reads go through
+// the buffer, large blobs are read into the frame directly
+struct TcpNetWrapper::Incoming {
+  ~Incoming() { if (fd >= 0) close(fd); }
+
+  int fd = -1;
+  int rank = -1;
+  std::vector<char> buffer;
+  size_t begin = 0;
+  size_t end = 0;
+  // nothing left in the socket until epoll tells otherwise
+  bool drained = true;
+  bool queued = false;
+  bool closed = false;
+  size_t frame_size = 0;
+  size_t frame_size_read = 0;
+  Blob frame;
+  size_t frame_read = 0;
+};
+
+TcpNetWrapper::TcpNetWrapper() : active_(false), rank_(-1), size_(0),
+  listen_fd_(-1), epoll_fd_(-1), send_epoll_fd_(-1) {}
+
+TcpNetWrapper::~TcpNetWrapper() {
+  if (active_) Finalize();
+}
+
+void TcpNetWrapper::Init(int*, char**) {
+  if (active_) return;
+  std::vector<std::string> machines;
+  net::ParseMachineFile(MV_CONFIG_machine_file, &machines);
+  CHECK(!machines.empty());
+  std::unordered_set<std::string> local_ip;
+  net::GetLocalIPAddress(&local_ip);
+
+  // rank is the first local entry that can be bound, so that ranks on the
+  // same host are told apart by port
+  size_ = static_cast<int>(machines.size());
+  endpoints_.clear();
+  for (auto& machine : machines) {
+    std::string endpoint = machine;
+    if (endpoint.find(':') == std::string::npos) {
+      endpoint += ":" + std::to_string(MV_CONFIG_port);
+    }
+    endpoints_.push_back(endpoint);
+    std::string host, port;
+    SplitEndpoint(endpoint, &host, &port);
+    if (rank_ < 0 && IsLocalHost(host, local_ip) && Listen(endpoint)) {
+      rank_ = static_cast<int>(endpoints_.size()) - 1;
+    }
+  }
+  if (rank_ < 0) {
+    Log::Fatal("No entry of machine file %s can be bound on this host\n",
+               MV_CONFIG_machine_file.c_str());
+  }
+  ConnectAll();
+  Log::Info("%s net util inited, rank = %d, size = %d\n",
+    name().c_str(), rank(), size());
+}
+
+bool TcpNetWrapper::Listen(const std::string& endpoint) {
+  sockaddr_in addr;
+  if (!Resolve(endpoint, &addr)) return false;
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  CHECK(fd >= 0);
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+      listen(fd, SOMAXCONN) != 0) {
+    close(fd);
+    return false;
+  }
+  listen_fd_ = fd;
+  return true;
+}
+
+int TcpNetWrapper::Bind(int rank, char* endpoint) {
+  rank_ = rank;
+  if (!Listen(endpoint)) {
+    Log::Error("Failed to bind the socket for receiver, ip:port = %s\n",
+               endpoint);
+    return -1;
+  }
+  return 0;
+}
+
+int TcpNetWrapper::Connect(int* ranks, char* endpoints[], int size) {
+  CHECK(listen_fd_ >= 0);
+  size_ = size;
+  endpoints_.resize(size_);
+  for (int i = 0; i < size; ++i) endpoints_[ranks[i]] = endpoints[i];
+  ConnectAll();
+  return 0;
+}
+
+void TcpNetWrapper::ConnectAll() {
+  int num_connections = std::max(MV_CONFIG_tcp_connections, 1);
+  // a batch packs msgs of several tables, which must stay in order with the
+  // msgs of each of them on other connections
+  if (num_connections > 1 && MV_CONFIG_comm_batch_size > 0) {
+    Log::Fatal("-tcp_connections above 1 can't be used with "
+               "-comm_batch_size\n");
+  }
+  outgoing_.clear(); outgoing_.resize(size_);
+  incoming_.clear(); incoming_.resize(size_);
+  fence_.assign(size_, 0);
+  epoll_fd_ = epoll_create1(0);
+  send_epoll_fd_ = epoll_create1(0);
+  CHECK(epoll_fd_ >= 0 && send_epoll_fd_ >= 0);
+  epoll_event send_event;
+  send_event.events = EPOLLIN;
+  send_event.data.ptr = nullptr;
+  CHECK(epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, send_epoll_fd_, &send_event) == 0);
+  // peers connect before they accept, the listen backlog holds them
+  for (int dst = 0; dst < size_; ++dst) {
+    if (dst == rank_) continue;
+    sockaddr_in addr;
+    if (!Resolve(endpoints_[dst], &addr)) {
+      Log::Fatal("Failed to resolve %s\n", endpoints_[dst].c_str());
+    }
+    for (int i = 0; i < num_connections; ++i) {
+      std::unique_ptr<Outgoing> out(new Outgoing());
+      for (int retry = 0; ; ++retry) {
+        out->fd = socket(AF_INET, SOCK_STREAM, 0);
+        CHECK(out->fd >= 0);
+        if (connect(out->fd, reinterpret_cast<sockaddr*>(&addr),
+                    sizeof(addr)) == 0) break;
+        close(out->fd);
+        if (retry == kConnectRetries) {
+          Log::Fatal("Failed to connect rank %d at %s\n", dst,
+                     endpoints_[dst].c_str());
+        }
+        std::this_thread::sleep_for(
+          std::chrono::milliseconds(kConnectRetryMs));
+      }
+      int on = 1;
+      setsockopt(out->fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+      // still blocking, so it is written at once
+      Handshake handshake = { rank_, i };
+      std::vector<iovec> iov = { { &handshake, sizeof(handshake) } };
+      size_t first = 0;
+      while (first < iov.size()) WriteSome(out->fd, &iov, &first);
+      out->rank = dst;
+      fcntl(out->fd, F_SETFL, fcntl(out->fd, F_GETFL, 0) | O_NONBLOCK);
+      // edge triggered, an event comes once a socket found full has room
+      epoll_event event;
+      event.events = EPOLLOUT | EPOLLET;
+      event.data.ptr = out.get();
+      CHECK(epoll_ctl(send_epoll_fd_, EPOLL_CTL_ADD, out->fd, &event) == 0);
+      outgoing_[dst].push_back(std::move(out));
+    }
+    incoming_[dst].resize(num_connections);
+  }
+
+  for (int i = 0; i < (size_ - 1) * num_connections; ++i) {
+    int fd = accept(listen_fd_, nullptr, nullptr);
+    if (fd < 0 && errno == EINTR) { --i; continue; }
+    CHECK(fd >= 0);
+    Handshake handshake;
+    ReadAll(fd, reinterpret_cast<char*>(&handshake), sizeof(handshake));
+    CHECK(handshake.rank >= 0 && handshake.rank < size_ &&
+          handshake.rank != rank_);
+    CHECK(handshake.index >= 0 && handshake.index < num_connections);
+    auto& in = incoming_[handshake.rank][handshake.index];
+    CHECK(in.get() == nullptr);
+    in.reset(new Incoming());
+    in->fd = fd;
+    in->rank = handshake.rank;
+    in->buffer.resize(kBufferSize);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = in.get();
+    CHECK(epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) == 0);
+  }
+  close(listen_fd_);
+  listen_fd_ = -1;
+  active_ = true;
+}
+
+void TcpNetWrapper::Finalize() {
+  // the msgs sent last may still be queued
+  while (Sending()) {
+    SendPending();
+    if (Sending()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(kWriteRetryMs));
+    }
+  }
+  ready_.clear();
+  outgoing_.clear();
+  incoming_.clear();
+  if (epoll_fd_ >= 0) close(epoll_fd_);
+  if (send_epoll_fd_ >= 0) close(send_epoll_fd_);
+  if (listen_fd_ >= 0) close(listen_fd_);
+  epoll_fd_ = send_epoll_fd_ = listen_fd_ = -1;
+  rank_ = -1;
+  active_ = false;
+}
+
+int TcpNetWrapper::Send(MessagePtr& msg) {
+  if (!msg.get()) return 0;
+  int dst = msg->dst();
+  auto& pool = outgoing_[dst];
+  CHECK(!pool.empty());
+  // Requests and replies of a table keep their order on its connection.
+  // Other msgs go on the first one after those sent on the others, and
+  // table msgs sent later go after them
+  bool table_msg = msg->table_id() >= 0 &&
+    (msg->type() == MsgType::Request_Get ||
+     msg->type() == MsgType::Request_Add ||
+     msg->type() == MsgType::Reply_Get || msg->type() == MsgType::Reply_Add);
+  Outgoing* out = pool[table_msg ? msg->table_id() % pool.size() : 0].get();
+  Pending pending;
+  if (pool.size() > 1) {
+    pending.fence.assign(pool.size(), 0);
+    if (table_msg) {
+      pending.fence[0] = fence_[dst];
+    } else {
+      for (size_t j = 0; j < pool.size(); ++j) {
+        pending.fence[j] = pool[j]->queued.load(std::memory_order_relaxed);
+      }
+      fence_[dst] = pending.fence[0] + 1;
+    }
+  }
+  std::vector<net::Segment> segments;
+  net::FrameSegments(msg, &pending.meta, &segments);
+  ToIovecs(segments, &pending.iov);
+  pending.msg = std::move(msg);
+  return Enqueue(out, &pending);
+}
+
+int TcpNetWrapper::Enqueue(Outgoing* out, Pending* pending) const {
+  {
+    std::lock_guard<std::mutex> lock(out->mutex);
+    out->queue.push_back(std::move(*pending));
+    out->queued.fetch_add(1, std::memory_order_relaxed);
+  }
+  return Flush(out->rank);
+}
+
+int TcpNetWrapper::SendPending() {
+  int size = 0;
+  for (int rank = 0; rank < size_; ++rank) {
+    if (!outgoing_[rank].empty()) size += Flush(rank);
+  }
+  return size;
+}
+
+bool TcpNetWrapper::Sending() const {
+  for (auto& pool : outgoing_) {
+    for (auto& out : pool) {
+      if (out->written.load(std::memory_order_acquire) !=
+          out->queued.load(std::memory_order_relaxed)) return true;
+    }
+  }
+  return false;
+}
+
+// An entry written on one connection may let one on another go
+int TcpNetWrapper::Flush(int rank) const {
+  auto& pool = outgoing_[rank];
+  int size = 0;
+  bool progress = true;
+  while (progress) {
+    progress = false;
+    for (auto& out : pool) {
+      std::lock_guard<std::mutex> lock(out->mutex);
+      unsigned long long written = out->written.load(std::memory_order_relaxed);
+      size += FlushLocked(out.get());
+      if (pool.size() > 1 &&
+          out->written.load(std::memory_order_relaxed) != written) {
+        progress = true;
+      }
+    }
+  }
+  return size;
+}
+
+int TcpNetWrapper::FlushLocked(Outgoing* out) const {
+  auto& pool = outgoing_[out->rank];
+  int size = 0;
+  while (!out->queue.empty()) {
+    Pending& pending = out->queue.front();
+    for (size_t j = 0; j < pending.fence.size(); ++j) {
+      if (pool[j]->written.load(std::memory_order_acquire) <
+          pending.fence[j]) return size;
+    }
+    size += static_cast<int>(
+      WriteSome(out->fd, &pending.iov, &pending.first));
+    if (pending.first < pending.iov.size()) return size;  // socket is full
+    out->queue.pop_front();
+    out->written.fetch_add(1, std::memory_order_release);
+  }
+  return size;
+}
+
+int TcpNetWrapper::Recv(MessagePtr* msg) {
+  epoll_event events[kMaxEvents];
+  int num_events = epoll_wait(epoll_fd_, events, kMaxEvents, 0);
+  for (int i = 0; i < num_events; ++i) {
+    Incoming* in = static_cast<Incoming*>(events[i].data.ptr);
+    if (in == nullptr) {
+      // outgoing sockets with room again
+      epoll_event send_events[kMaxEvents];
+      int num_send_events = epoll_wait(send_epoll_fd_, send_events,
+                                       kMaxEvents, 0);
+      for (int j = 0; j < num_send_events; ++j) {
+        Flush(static_cast<Outgoing*>(send_events[j].data.ptr)->rank);
+      }
+      continue;
+    }
+    in->drained = false;
+    if (!in->queued) {
+      in->queued = true;
+      ready_.push_back(in);
+    }
+  }
+  while (!ready_.empty()) {
+    Incoming* in = ready_.front();
+    ready_.pop_front();
+    in->queued = false;
+    int size = RecvFrame(in, msg);
+    // take turns with the other connections
+    if (!in->closed && (!in->drained || in->begin < in->end)) {
+      in->queued = true;
+      ready_.push_back(in);
+    }
+    if (size > 0) return size;
+  }
+  return 0;
+}
+
+// The epoll fd is readable once an incoming connection is, or an outgoing
+// one is writable again
+void TcpNetWrapper::WaitRecv(long long timeout_us) {
+  if (!ready_.empty()) return;
+  pollfd wait_fd = { epoll_fd_, POLLIN, 0 };
+  timespec timeout = { static_cast<time_t>(timeout_us / 1000000),
+                       static_cast<long>(timeout_us % 1000000 * 1000) };
+  ppoll(&wait_fd, 1, &timeout, nullptr);
+}
+
+int TcpNetWrapper::RecvFrame(Incoming* in, MessagePtr* msg) {
+  if (in->frame_size_read < sizeof(size_t)) {
+    in->frame_size_read += Fill(in,
+      reinterpret_cast<char*>(&in->frame_size) + in->frame_size_read,
+      sizeof(size_t) - in->frame_size_read);
+    if (in->frame_size_read < sizeof(size_t)) {
+      if (in->closed) Close(in);
+      return 0;
+    }
+    in->frame = Blob(in->frame_size);
+    in->frame_read = 0;
+  }
+  in->frame_read += Fill(in, in->frame.data() + in->frame_read,
+                         in->frame_size - in->frame_read);
+  if (in->frame_read < in->frame_size) {
+    if (in->closed) Close(in);
+    return 0;
+  }
+
+  net::ParseFrame(in->frame, msg);
+  int size = static_cast<int>(in->frame_size + sizeof(size_t));
+  in->frame = Blob();
+  in->frame_size_read = 0;
+  return size;
+}
+
+size_t TcpNetWrapper::Fill(Incoming* in, char* dst, size_t size) const {
+  size_t got = 0;
+  while (got < size) {
+    if (in->begin < in->end) {
+      size_t n = std::min(size - got, in->end - in->begin);
+      memcpy(dst + got, in->buffer.data() + in->begin, n);
+      in->begin += n;
+      got += n;
+      continue;
+    }
+    if (in->drained || in->closed) break;
+    bool direct = size - got >= kBufferSize;
+    ssize_t n = recv(in->fd, direct ? dst + got : in->buffer.data(),
+                     direct ? size - got : kBufferSize, 0);
+    if (n > 0) {
+      if (direct) {
+        got += static_cast<size_t>(n);
+      } else {
+        in->begin = 0;
+        in->end = static_cast<size_t>(n);
+      }
+    } else if (n == 0) {
+      in->closed = true;
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      in->drained = true;
+    } else if (errno != EINTR) {
+      Log::Error("Failed to read from rank %d, errno = %d\n", in->rank, errno);
+      in->closed = true;
+    }
+  }
+  return got;
+}
+
+void TcpNetWrapper::Close(Incoming* in) {
+  if (in->frame_size_read > 0) {
+    Log::Error("Connection from rank %d closed within a msg\n", in->rank);
+  }
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, in->fd, nullptr);
+  close(in->fd);
+  in->fd = -1;
+}
+
+// Blocking, the data is queued after the msgs on the first connection
+void TcpNetWrapper::SendTo(int rank, char* buf, int len) const {
+  if (len <= 0) return;
+  Outgoing* out = outgoing_[rank][0].get();
+  Pending pending;
+  pending.iov = { { buf, static_cast<size_t>(len) } };
+  unsigned long long id;
+  {
+    std::lock_guard<std::mutex> lock(out->mutex);
+    out->queue.push_back(std::move(pending));
+    id = out->queued.fetch_add(1, std::memory_order_relaxed) + 1;
+  }
+  while (true) {
+    Flush(rank);
+    if (out->written.load(std::memory_order_acquire) >= id) break;
+    pollfd poll_fd = { out->fd, POLLOUT, 0 };
+    poll(&poll_fd, 1, kWriteRetryMs);
+  }
+}
+
+void TcpNetWrapper::RecvFrom(int rank, char* buf, int len) const {
+  Incoming* in = incoming_[rank][0].get();
+  size_t got = 0;
+  while (true) {
+    in->drained = false;
+    got += Fill(in, buf + got, static_cast<size_t>(len) - got);
+    if (got == static_cast<size_t>(len)) break;
+    if (in->closed) Log::Fatal("Connection from rank %d closed\n", rank);
+    pollfd poll_fd = { in->fd, POLLIN, 0 };
+    poll(&poll_fd, 1, -1);
+  }
+}
+
+void TcpNetWrapper::SendRecv(int send_rank, char* send_buf, int send_len,
+  int recv_rank, char* recv_buf, int recv_len) const {
+  // the peer reads while it sends, as sends are not buffered here
+  std::thread sender([&]() { SendTo(send_rank, send_buf, send_len); });
+  RecvFrom(recv_rank, recv_buf, recv_len);
+  sender.join();
+}
+
+}  // namespace multiverso
+
+#endif  // MULTIVERSO_USE_TCP
@@ -1,8 +1,12 @@
 #include "multiverso/server.h"
 
 #include <algorithm>
+#include <atomic>
+#include <memory>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include "multiverso/actor.h"
@@ -11,6 +15,7 @@
 #include "multiverso/table_interface.h"
 #include "multiverso/io/io.h"
 #include "multiverso/util/configure.h"
+#include "multiverso/util/mpsc_queue.h"
 #include "multiverso/util/mt_queue.h"
 #include "multiverso/zoo.h"
 
@@ -19,22 +24,228 @@ namespace multiverso {
 
 MV_DEFINE_bool(sync, false, "sync or async");
 MV_DEFINE_int(backup_worker_ratio, 0, "ratio% of backup workers, set 20 means 20%");
+MV_DEFINE_int(server_threads, 1, "threads executing the requests of a server, "
+              "each for its shard of the rows of tables that split them, "
+              "or for whole tables, one thread for each");
+MV_DEFINE_bool(server_combine_adds, false, "sum the deltas of the Adds "
+               "waiting for a table before applying them, for tables and "
+               "updaters that support it");
 
-Server::Server() : Actor(actor::kServer) {
+// A request of a sharded table, executed by every executor for the rows of
+// its shard. The last one to finish sends the reply
+struct Server::ShardedRequest {
+  MessagePtr msg;
+  MessagePtr reply;
+  std::atomic<int> pending;
+};
+
+// Executes the requests dispatched to it in order, on its own thread. Those
+// of sharded tables are executed for shard id
+class Server::Executor {
+public:
+  Executor(Server* server, int id) : server_(server), id_(id),
+    monitor_("SERVER_EXECUTOR_" + std::to_string(id)),
+    thread_(&Executor::Main, this) {}
+
+  // Requests already dispatched are executed first
+  ~Executor() {
+    queue_.Exit();
+    thread_.join();
+    Dashboard::RemoveMonitor(monitor_.name());
+  }
+
+  void Push(MessagePtr& msg) {
+    Task task;
+    task.msg = std::move(msg);
+    queue_.Push(task);
+  }
+  void Push(const std::shared_ptr<ShardedRequest>& request) {
+    Task task;
+    task.request = request;
+    queue_.Push(task);
+  }
+
+private:
+  // A msg of a table of this executor, or a request of a sharded table
+  struct Task {
+    MessagePtr msg;
+    std::shared_ptr<ShardedRequest> request;
+  };
+
+  void Main() {
+    std::vector<Task> tasks;
+    std::vector<MessagePtr> msgs;
+    std::vector<std::shared_ptr<ShardedRequest>> requests;
+    while (queue_.PopBatch(&tasks)) {
+      monitor_.Begin();
+      // tables are independent, only the order within each one is kept
+      for (Task& task : tasks) {
+        if (task.request != nullptr) {
+          requests.push_back(std::move(task.request));
+        } else {
+          msgs.push_back(std::move(task.msg));
+        }
+      }
+      if (!msgs.empty()) server_->ExecuteBatch(msgs);
+      if (!requests.empty()) server_->ExecuteShard(requests, id_);
+      monitor_.End();
+      tasks.clear();
+      msgs.clear();
+      requests.clear();
+    }
+  }
+
+  Server* server_;
+  int id_;
+  MpscQueue<Task> queue_;
+  Monitor monitor_;
+  std::thread thread_;
+};
+
+Server::Server() : Actor(actor::kServer),
+  combine_adds_(MV_CONFIG_server_combine_adds) {
   RegisterHandler(MsgType::Request_Get, std::bind(
     &Server::ProcessGet, this, std::placeholders::_1));
   RegisterHandler(MsgType::Request_Add, std::bind(
     &Server::ProcessAdd, this, std::placeholders::_1));
 }
 
+Server::~Server() {}
+
+void Server::Main() {
+  for (int i = 0; MV_CONFIG_server_threads > 1 &&
+                  i < MV_CONFIG_server_threads; ++i) {
+    executors_.emplace_back(new Executor(this, i));
+  }
+  Actor::Main();
+  executors_.clear();
+}
+
 int Server::RegisterTable(ServerTable* server_table) {
   int id = static_cast<int>(store_.size());
   store_.push_back(server_table);
   return id;
 }
 
+void Server::ProcessBatch(std::vector<MessagePtr>& msgs) {
+  if (!combine_adds_ || !executors_.empty()) {
+    Actor::ProcessBatch(msgs);
+    return;
+  }
+  MONITOR_BEGIN(SERVER_PROCESS_BATCH)
+  ExecuteBatch(msgs);
+  MONITOR_END(SERVER_PROCESS_BATCH)
+}
+
 void Server::ProcessGet(MessagePtr& msg) {
+  if (!executors_.empty()) {
+    Dispatch(msg);
+    return;
+  }
   MONITOR_BEGIN(SERVER_PROCESS_GET);
+  ExecuteGet(msg);
+  MONITOR_END(SERVER_PROCESS_GET);
+}
+
+void Server::ProcessAdd(MessagePtr& msg) {
+  if (!executors_.empty()) {
+    Dispatch(msg);
+    return;
+  }
+  MONITOR_BEGIN(SERVER_PROCESS_ADD)
+  ExecuteAdd(msg);
+  MONITOR_END(SERVER_PROCESS_ADD)
+}
+
+void Server::Dispatch(MessagePtr& msg) {
+  int table_id = msg->table_id();
+  CHECK(table_id >= 0 && table_id < static_cast<int>(store_.size()));
+  ServerTable* table = store_[table_id];
+  if (!table->Sharded()) {
+    executors_[table_id % executors_.size()]->Push(msg);
+    return;
+  }
+  if (msg->data().size() == 0) return;
+  std::shared_ptr<ShardedRequest> request(new ShardedRequest);
+  request->reply.reset(msg->CreateReplyMessage());
+  if (msg->type() == MsgType::Request_Get) {
+    table->PrepareGet(msg->data(), &request->reply->data());
+  }
+  request->pending = static_cast<int>(executors_.size());
+  request->msg = std::move(msg);
+  for (auto& executor : executors_) executor->Push(request);
+}
+
+void Server::ExecuteBatch(std::vector<MessagePtr>& msgs) {
+  if (!combine_adds_) {
+    for (MessagePtr& msg : msgs) {
+      if (msg->type() == MsgType::Request_Get) {
+        ExecuteGet(msg);
+      } else {
+        ExecuteAdd(msg);
+      }
+    }
+    return;
+  }
+  // Adds waiting by table, a Get of the table sees them applied
+  std::unordered_map<int, std::vector<MessagePtr>> adds;
+  for (MessagePtr& msg : msgs) {
+    if (msg->type() == MsgType::Request_Add) {
+      adds[msg->table_id()].push_back(std::move(msg));
+      continue;
+    }
+    CHECK(msg->type() == MsgType::Request_Get);
+    auto it = adds.find(msg->table_id());
+    if (it != adds.end()) {
+      ExecuteAdds(it->second);
+      adds.erase(it);
+    }
+    ExecuteGet(msg);
+  }
+  for (auto& table_adds : adds) ExecuteAdds(table_adds.second);
+}
+
+void Server::ExecuteShard(
+  std::vector<std::shared_ptr<ShardedRequest>>& requests, int shard) {
+  int num_shards = static_cast<int>(executors_.size());
+  // Adds waiting by table, as in ExecuteBatch
+  std::unordered_map<int, std::vector<ShardedRequest*>> adds;
+  auto execute_adds = [&](std::vector<ShardedRequest*>& table_adds) {
+    std::vector<const std::vector<Blob>*> data;
+    for (ShardedRequest* request : table_adds) {
+      data.push_back(&request->msg->data());
+    }
+    store_[table_adds[0]->msg->table_id()]->AddShard(data, shard, num_shards);
+    for (ShardedRequest* request : table_adds) FinishShard(request);
+  };
+  for (auto& request : requests) {
+    Message* msg = request->msg.get();
+    if (msg->type() == MsgType::Request_Add) {
+      adds[msg->table_id()].push_back(request.get());
+      if (!combine_adds_) {
+        execute_adds(adds[msg->table_id()]);
+        adds.clear();
+      }
+      continue;
+    }
+    CHECK(msg->type() == MsgType::Request_Get);
+    auto it = adds.find(msg->table_id());
+    if (it != adds.end()) {
+      execute_adds(it->second);
+      adds.erase(it);
+    }
+    store_[msg->table_id()]->GetShard(msg->data(), &request->reply->data(),
+                                      shard, num_shards);
+    FinishShard(request.get());
+  }
+  for (auto& table_adds : adds) execute_adds(table_adds.second);
+}
+
+void Server::FinishShard(ShardedRequest* request) {
+  if (--request->pending == 0) SendTo(actor::kCommunicator, request->reply);
+}
+
+void Server::ExecuteGet(MessagePtr& msg) {
   if (msg->data().size() != 0) {
     MessagePtr reply(msg->CreateReplyMessage());
     int table_id = msg->table_id();
@@ -42,11 +253,9 @@ void Server::ProcessGet(MessagePtr& msg) {
     store_[table_id]->ProcessGet(msg->data(), &reply->data());
     SendTo(actor::kCommunicator, reply);
   }
-  MONITOR_END(SERVER_PROCESS_GET);
 }
 
-void Server::ProcessAdd(MessagePtr& msg) {
-  MONITOR_BEGIN(SERVER_PROCESS_ADD)
+void Server::ExecuteAdd(MessagePtr& msg) {
   if (msg->data().size() != 0) {
     MessagePtr reply(msg->CreateReplyMessage());
     int table_id = msg->table_id();
@@ -54,7 +263,26 @@ void Server::ProcessAdd(MessagePtr& msg) {
     store_[table_id]->ProcessAdd(msg->data());
     SendTo(actor::kCommunicator, reply);
   }
-  MONITOR_END(SERVER_PROCESS_ADD)
+}
+
+void Server::ExecuteAdds(std::vector<MessagePtr>& msgs) {
+  if (msgs.size() == 1) {
+    ExecuteAdd(msgs[0]);
+    return;
+  }
+  int table_id = msgs[0]->table_id();
+  CHECK(table_id >= 0 && table_id < static_cast<int>(store_.size()));
+  std::vector<const std::vector<Blob>*> data;
+  for (MessagePtr& msg : msgs) {
+    if (msg->data().size() != 0) data.push_back(&msg->data());
+  }
+  store_[table_id]->ProcessAdds(data);
+  for (MessagePtr& msg : msgs) {
+    if (msg->data().size() != 0) {
+      MessagePtr reply(msg->CreateReplyMessage());
+      SendTo(actor::kCommunicator, reply);
+    }
+  }
 }
 
 
@@ -74,6 +302,8 @@ public:
     worker_get_clocks_.reset(new VectorClock(num_worker));
     worker_add_clocks_.reset(new VectorClock(num_worker));
     num_waited_add_.resize(num_worker, 0);
+    // Adds are held back by the clocks of their workers, one by one
+    combine_adds_ = false;
   }
 
   // make some modification to suit to the sync server
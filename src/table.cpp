@@ -1,22 +1,40 @@
 #include "multiverso/table_interface.h"
 
+#include <condition_variable>
+#include <limits>
 #include <mutex>
+#include <utility>
 
 #include "multiverso/dashboard.h"
 #include "multiverso/updater/updater.h"
+#include "multiverso/util/configure.h"
 #include "multiverso/util/log.h"
-#include "multiverso/util/waiter.h"
 #include "multiverso/zoo.h"
 
 namespace multiverso {
 
+MV_DEFINE_int(table_async_slots, 4096, "max async ops of a worker table in "
+              "flight, a new op waits for the oldest beyond that");
+
+namespace {
+// Whether this thread runs a completion callback, which is the worker
+// actor thread, the only one that frees slots
+thread_local bool t_in_callback = false;
+}  // namespace
+
 WorkerTable::WorkerTable() {
   msg_id_ = 0;
   m_ = new std::mutex();
+  done_ = new std::condition_variable();
+  CHECK(MV_CONFIG_table_async_slots > 0);
+  slots_.resize(MV_CONFIG_table_async_slots, Slot{ -1, 0, nullptr });
+  id_period_ = std::numeric_limits<int>::max() /
+    MV_CONFIG_table_async_slots * MV_CONFIG_table_async_slots;
   table_id_ = Zoo::Get()->RegisterTable(this);
 }
 
 WorkerTable::~WorkerTable() {
+  delete done_;
   delete m_;
 }
 
@@ -40,11 +58,30 @@ void WorkerTable::Add(Blob keys, Blob values,
 
 int WorkerTable::GetAsync(Blob keys,
                           const GetOption* option) {
-  m_->lock();
-  int id = msg_id_++;
-  waitings_.push_back(new Waiter());
-  m_->unlock();
-  MessagePtr msg(new Message());
+  return GetAsync(keys, option, nullptr);
+}
+
+int WorkerTable::GetAsync(Blob keys, const GetOption* option,
+                          const Callback& done) {
+  int id = NewOp(done);
+  SendGet(id, keys, option);
+  return id;
+}
+
+int WorkerTable::AddAsync(Blob keys, Blob values,
+                          const AddOption* option) {
+  return AddAsync(keys, values, option, nullptr);
+}
+
+int WorkerTable::AddAsync(Blob keys, Blob values, const AddOption* option,
+                          const Callback& done) {
+  int id = NewOp(done);
+  SendAdd(id, keys, values, option);
+  return id;
+}
+
+void WorkerTable::SendGet(int id, Blob keys, const GetOption* option) {
+  MessagePtr msg(Message::Create());
   msg->set_src(Zoo::Get()->rank());
   msg->set_type(MsgType::Request_Get);
   msg->set_msg_id(id);
@@ -56,16 +93,11 @@ int WorkerTable::GetAsync(Blob keys,
     msg->Push(general_option);
   }
   Zoo::Get()->SendTo(actor::kWorker, msg);
-  return id;
 }
 
-int WorkerTable::AddAsync(Blob keys, Blob values,
+void WorkerTable::SendAdd(int id, Blob keys, Blob values,
                           const AddOption* option) {
-  m_->lock();
-  int id = msg_id_++;
-  waitings_.push_back(new Waiter());
-  m_->unlock();
-  MessagePtr msg(new Message());
+  MessagePtr msg(Message::Create());
   msg->set_src(Zoo::Get()->rank());
   msg->set_type(MsgType::Request_Add);
   msg->set_msg_id(id);
@@ -78,36 +110,119 @@ int WorkerTable::AddAsync(Blob keys, Blob values,
     msg->Push(update_option);
   }
   Zoo::Get()->SendTo(actor::kWorker, msg);
+}
+
+int WorkerTable::NewOp(const Callback& done) {
+  std::unique_lock<std::mutex> lock(*m_);
+  int id = msg_id_;
+  msg_id_ = (msg_id_ + 1) % id_period_;
+  Slot* slot = &slots_[id % slots_.size()];
+  if (slot->msg_id >= 0 && slot->num_wait > 0) {
+    if (t_in_callback) {
+      // waiting here would block the thread the slot waits for, keep the
+      // op aside until it is done
+      slot = &overflow_[id];
+    } else {
+      while (slot->msg_id >= 0 && slot->num_wait > 0) done_->wait(lock);
+    }
+  }
+  slot->msg_id = id;
+  slot->num_wait = 1;  // until Reset by the worker
+  slot->done = done;
   return id;
 }
 
+void WorkerTable::Then(int id, const Callback& done) {
+  std::unique_lock<std::mutex> lock(*m_);
+  if (Done(id)) {
+    lock.unlock();
+    done();
+    return;
+  }
+  Slot* slot = Find(id);
+  CHECK(!slot->done);
+  slot->done = done;
+}
+
+void WorkerTable::Count(int id, int num_wait, bool reset) {
+  Callback done;
+  {
+    std::lock_guard<std::mutex> lock(*m_);
+    Slot* slot = Find(id);
+    CHECK_NOTNULL(slot);
+    if (reset) {
+      slot->num_wait = num_wait;
+    } else {
+      CHECK(slot->num_wait > 0);
+      --slot->num_wait;
+    }
+    if (slot->num_wait > 0) return;
+    // before any wait returns, the table may be gone after that
+    ProcessDone(id);
+    // the slot may be taken again while the callback runs
+    std::swap(done, slot->done);
+    if (slot != &slots_[id % slots_.size()]) overflow_.erase(id);
+    done_->notify_all();
+  }
+  if (done) {
+    bool in_callback = t_in_callback;
+    t_in_callback = true;
+    done();
+    t_in_callback = in_callback;
+  }
+}
+
+WorkerTable::Slot* WorkerTable::Find(int id) {
+  Slot& slot = slots_[id % slots_.size()];
+  if (slot.msg_id == id) return &slot;
+  auto it = overflow_.find(id);
+  return it == overflow_.end() ? nullptr : &it->second;
+}
+
+bool WorkerTable::Done(int id) {
+  CHECK(id >= 0 && id < id_period_);
+  const Slot* slot = Find(id);
+  return slot == nullptr || slot->num_wait == 0;
+}
+
 void WorkerTable::Wait(int id) {
-  // CHECK(waitings_.find(id) != waitings_.end());
-  m_->lock();
-  CHECK(waitings_[id] != nullptr);
-  Waiter* w = waitings_[id];
-  m_->unlock();
+  std::unique_lock<std::mutex> lock(*m_);
+  while (!Done(id)) done_->wait(lock);
+}
 
-  w->Wait();
+bool WorkerTable::TryWait(int id) {
+  std::lock_guard<std::mutex> lock(*m_);
+  return Done(id);
+}
+
+int WorkerTable::WaitAny(const std::vector<int>& ids) {
+  CHECK(!ids.empty());
+  std::unique_lock<std::mutex> lock(*m_);
+  while (true) {
+    for (size_t i = 0; i < ids.size(); ++i) {
+      if (Done(ids[i])) return static_cast<int>(i);
+    }
+    done_->wait(lock);
+  }
+}
+
+void WorkerTable::WaitAll(const std::vector<int>& ids) {
+  std::unique_lock<std::mutex> lock(*m_);
+  for (int id : ids) {
+    while (!Done(id)) done_->wait(lock);
+  }
+}
 
-  m_->lock();
-  delete waitings_[id];
-  waitings_[id] = nullptr;
-  m_->unlock();
+void WorkerTable::ProcessReplyGet(std::vector<Blob>&) {
+  Log::Fatal("Table %d does not process Get replies\n", table_id_);
 }
 
 void WorkerTable::Reset(int msg_id, int num_wait) {
-  m_->lock();
-  CHECK_NOTNULL(waitings_[msg_id]);
-  waitings_[msg_id]->Reset(num_wait);
-  m_->unlock();
+  Count(msg_id, num_wait, true);
 }
 
 void WorkerTable::Notify(int id) {
-  m_->lock();
-  CHECK_NOTNULL(waitings_[id]);
-  waitings_[id]->Notify();
-  m_->unlock();
+  Count(id, 0, false);
 }
 
 }  // namespace multiverso
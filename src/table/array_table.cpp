@@ -49,8 +49,9 @@ void ArrayWorker<T>::Add(T* data, size_t size, const AddOption* option) {
   CHECK(size == size_);
   integer_t all_key = -1;
 
-  Blob key(&all_key, sizeof(integer_t));
-  Blob val(data, sizeof(T) * size);
+  // data is not touched until the Add is done, no need to copy
+  Blob key = Blob::Wrap(&all_key, sizeof(integer_t));
+  Blob val = Blob::Wrap(data, sizeof(T) * size);
   WorkerTable::Add(key, val, option);
   Log::Debug("worker %d adding parameters with size of %d.\n", MV_Rank(), size);
 }
@@ -74,7 +75,7 @@ int ArrayWorker<T>::Partition(const std::vector<Blob>& kv,
   if (kv.size() >= 2) {
     CHECK(kv[1].size() == size_ * sizeof(T));
     for (int i = 0; i < num_server_; ++i) {
-      Blob blob(kv[1].data() + server_offsets_[i] * sizeof(T),
+      Blob blob(kv[1], server_offsets_[i] * sizeof(T),
         (server_offsets_[i + 1] - server_offsets_[i]) * sizeof(T));
       (*out)[i].push_back(blob);
       if (kv.size() == 3) {// update option blob
@@ -114,30 +115,54 @@ ArrayServer<T>::ArrayServer(const ArrayTableOption<T> &option)
 
 template <typename T>
 void ArrayServer<T>::ProcessAdd(const std::vector<Blob>& data) {
-  Blob keys = data[0], values = data[1];
-  AddOption* option = nullptr;
-  if (data.size() == 3)
-    option = new AddOption(data[2].data(), data[2].size());
-  // Always request whole table
-  CHECK(keys.size<integer_t>() == 1 && keys.As<integer_t>() == -1); 
-  CHECK(values.size() == size_ * sizeof(T));
-  T* pvalues = reinterpret_cast<T*>(values.data());
-  updater_->Update(size_, storage_.data(), pvalues, option);
-  delete option;
+  AddShard({ &data }, 0, 1);
+}
+
+template <typename T>
+void ArrayServer<T>::AddShard(const std::vector<const std::vector<Blob>*>& adds,
+                              int shard, int num_shards) {
+  size_t begin, end;
+  ShardRange(shard, num_shards, &begin, &end);
+  for (auto data : adds) {
+    Blob keys = (*data)[0], values = (*data)[1];
+    AddOption* option = nullptr;
+    if (data->size() == 3)
+      option = new AddOption((*data)[2].data(), (*data)[2].size());
+    // Always request whole table
+    CHECK(keys.size<integer_t>() == 1 && keys.As<integer_t>() == -1);
+    CHECK(values.size() == size_ * sizeof(T));
+    T* pvalues = reinterpret_cast<T*>(values.data());
+    updater_->Update(end - begin, storage_.data(), pvalues + begin, option,
+                     begin);
+    delete option;
+  }
 }
 
 template <typename T>
 void ArrayServer<T>::ProcessGet(const std::vector<Blob>& data,
+  std::vector<Blob>* result) {
+  PrepareGet(data, result);
+  GetShard(data, result, 0, 1);
+}
+
+template <typename T>
+void ArrayServer<T>::PrepareGet(const std::vector<Blob>& data,
   std::vector<Blob>* result) {
   size_t key_size = data[0].size<integer_t>();
   CHECK(key_size == 1 && data[0].As<integer_t>() == -1); 
   // Always request the whole table
   Blob key(sizeof(integer_t)); key.As<integer_t>() = server_id_;
-  Blob values(sizeof(T) * size_);
-  T* pvalues = reinterpret_cast<T*>(values.data());
-  updater_->Access(size_, storage_.data(), pvalues);
   result->push_back(key);
-  result->push_back(values);
+  result->push_back(Blob(sizeof(T) * size_));
+}
+
+template <typename T>
+void ArrayServer<T>::GetShard(const std::vector<Blob>& data,
+  std::vector<Blob>* result, int shard, int num_shards) {
+  size_t begin, end;
+  ShardRange(shard, num_shards, &begin, &end);
+  T* pvalues = reinterpret_cast<T*>((*result)[1].data());
+  updater_->Access(end - begin, storage_.data(), pvalues + begin, begin);
 }
 
 template <typename T>
@@ -2,6 +2,8 @@
 
 #include <vector>
 #include <algorithm>
+#include <mutex>
+#include <utility>
 
 #include "multiverso/io/io.h"
 #include "multiverso/multiverso.h"
@@ -17,9 +19,10 @@ MatrixWorker(option.num_row, option.num_col, option.is_sparse) {}
 
 template <typename T>
 MatrixWorker<T>::MatrixWorker(integer_t num_row, integer_t num_col, bool is_sparse) :
-WorkerTable(), num_row_(num_row), num_col_(num_col), is_sparse_(is_sparse) {
+WorkerTable(), num_row_(num_row), num_col_(num_col),
+  is_sparse_(is_sparse) {
   row_size_ = num_col * sizeof(T);
-  get_reply_count_ = 0;
+  row_indexes_mutex_ = new std::mutex();
 
   num_server_ = MV_NumServers();
   // compute row offsets in all servers
@@ -50,13 +53,12 @@ WorkerTable(), num_row_(num_row), num_col_(num_col), is_sparse_(is_sparse) {
     MV_Rank(), num_row, num_col);
   if (is_sparse_)
     Log::Debug("[Init] worker = %d, with sparse updater.\n", MV_Rank());
-  row_index_ = new T*[num_row_ + 1];
 }
 
 template <typename T>
 MatrixWorker<T>::~MatrixWorker() {
   server_offsets_.clear();
-  delete[]row_index_;
+  delete row_indexes_mutex_;
 }
 
 template <typename T>
@@ -71,14 +73,14 @@ template <typename T>
 void MatrixWorker<T>::Get(integer_t row_id, T* data, size_t size,
   const GetOption* option) {
   if (row_id >= 0) CHECK(size == num_col_);
-  for (auto i = 0; i < num_row_ + 1; ++i) row_index_[i] = nullptr;
   // row_index are used to hold the address that from user code
   //    so that multiverso can write back to user code.
+  RowIndex<T> row_index(num_col_);
   if (row_id == -1) {
-    row_index_[num_row_] = data;
+    row_index.SetWholeTable(data);
   }
   else {
-    row_index_[row_id] = data;  // data_ = data;
+    row_index.Set(row_id, data);
   }
 
   bool is_option_mine = false;
@@ -88,7 +90,8 @@ void MatrixWorker<T>::Get(integer_t row_id, T* data, size_t size,
     option = new GetOption();
   }
 
-  WorkerTable::Get(Blob(&row_id, sizeof(integer_t)), option);
+  Wait(StartGet(Blob(&row_id, sizeof(integer_t)), std::move(row_index),
+                option));
   Log::Debug("[Get] worker = %d, #row = %d\n", MV_Rank(), row_id);
 
   if (is_option_mine) delete option;
@@ -100,9 +103,10 @@ void MatrixWorker<T>::Get(const std::vector<integer_t>& row_ids,
   size_t size, const GetOption* option) {
   CHECK(size == num_col_);
   CHECK(row_ids.size() == data_vec.size());
-  for (auto i = 0; i < num_row_ + 1; ++i) row_index_[i] = nullptr;
+  RowIndex<T> row_index(num_col_);
+  row_index.Reserve(row_ids.size());
   for (auto i = 0; i < row_ids.size(); ++i) {
-    row_index_[row_ids[i]] = data_vec[i];
+    row_index.Set(row_ids[i], data_vec[i]);
   }
 
   bool is_option_mine = false;
@@ -112,7 +116,8 @@ void MatrixWorker<T>::Get(const std::vector<integer_t>& row_ids,
     option = new GetOption();
   }
 
-  WorkerTable::Get(Blob(row_ids.data(), sizeof(integer_t)* row_ids.size()), option);
+  Wait(StartGet(Blob(row_ids.data(), sizeof(integer_t)* row_ids.size()),
+                std::move(row_index), option));
   Log::Debug("[Get] worker = %d, #rows_set = %d / %d\n",
     MV_Rank(), row_ids.size(), num_row_);
 
@@ -124,9 +129,10 @@ void MatrixWorker<T>::Get(T* data, size_t size, integer_t* row_ids,
   integer_t row_ids_size,
   const GetOption* option) {
   CHECK(size == num_col_ * row_ids_size);
-  for (auto i = 0; i < num_row_ + 1; ++i) row_index_[i] = nullptr;
+  RowIndex<T> row_index(num_col_);
+  row_index.Reserve(row_ids_size);
   for (auto i = 0; i < row_ids_size; ++i) {
-    row_index_[row_ids[i]] = &data[i * num_col_];
+    row_index.Set(row_ids[i], &data[i * num_col_]);
   }
   Blob ids_blob(row_ids, sizeof(integer_t) * row_ids_size);
 
@@ -137,7 +143,7 @@ void MatrixWorker<T>::Get(T* data, size_t size, integer_t* row_ids,
     option = new GetOption();
   }
 
-  WorkerTable::Get(ids_blob, option);
+  Wait(StartGet(ids_blob, std::move(row_index), option));
   Log::Debug("[Get] worker = %d, #rows_set = %d / %d\n",
     MV_Rank(), row_ids_size, num_row_);
   if (is_option_mine) delete option;
@@ -185,8 +191,9 @@ template <typename T>
 void MatrixWorker<T>::Add(integer_t row_id, T* data, size_t size,
   const AddOption* option) {
   if (row_id >= 0) CHECK(size == num_col_);
-  Blob ids_blob(&row_id, sizeof(integer_t));
-  Blob data_blob(data, size * sizeof(T));
+  // data is not touched until the Add is done, no need to copy
+  Blob ids_blob = Blob::Wrap(&row_id, sizeof(integer_t));
+  Blob data_blob = Blob::Wrap(data, size * sizeof(T));
 
   bool is_option_mine = false;
   if (is_sparse_ && option == nullptr) {
@@ -206,7 +213,8 @@ void MatrixWorker<T>::Add(const std::vector<integer_t>& row_ids,
   size_t size,
   const AddOption* option) {
   CHECK(size == num_col_);
-  Blob ids_blob(&row_ids[0], sizeof(integer_t)* row_ids.size());
+  Blob ids_blob = Blob::Wrap(const_cast<integer_t*>(row_ids.data()),
+                             sizeof(integer_t)* row_ids.size());
   Blob data_blob(row_ids.size() * row_size_);
   // copy each row
   for (auto i = 0; i < row_ids.size(); ++i) {
@@ -230,8 +238,8 @@ void MatrixWorker<T>::Add(T* data, size_t size, integer_t* row_ids,
   integer_t row_ids_size,
   const AddOption* option) {
   CHECK(size == num_col_ * row_ids_size);
-  Blob ids_blob(row_ids, sizeof(integer_t) * row_ids_size);
-  Blob data_blob(data, row_ids_size * row_size_);
+  Blob ids_blob = Blob::Wrap(row_ids, sizeof(integer_t) * row_ids_size);
+  Blob data_blob = Blob::Wrap(data, row_ids_size * row_size_);
 
   bool is_option_mine = false;
   if (is_sparse_ && option == nullptr) {
@@ -265,7 +273,7 @@ int MatrixWorker<T>::Partition(const std::vector<Blob>& kv,
     if (partition_type == MsgType::Request_Add) {
       for (integer_t i = 0; i < num_server_; ++i) {
         int rank = MV_ServerIdToRank(i);
-        Blob blob(kv[1].data() + server_offsets_[i] * row_size_,
+        Blob blob(kv[1], server_offsets_[i] * row_size_,
           (server_offsets_[i + 1] - server_offsets_[i]) * row_size_);
         (*out)[rank].push_back(blob);
         if (kv.size() == 3) {  // adding update options
@@ -280,8 +288,6 @@ int MatrixWorker<T>::Partition(const std::vector<Blob>& kv,
           (*out)[rank].push_back(kv[1]);
         }
       }
-      CHECK(get_reply_count_ == 0);
-      get_reply_count_ = static_cast<int>(out->size());
     }
     return static_cast<int>(out->size());
   }
@@ -297,29 +303,45 @@ int MatrixWorker<T>::Partition(const std::vector<Blob>& kv,
     dest.push_back(dst);
     ++count[dst];
   }
-  for (auto i = 0; i < num_server_; i++) {  // allocate memory for blobs
-    int rank = MV_ServerIdToRank(i);
-    if (count[i] != 0) {
-      std::vector<Blob>& vec = (*out)[rank];
-      vec.push_back(Blob(count[i] * sizeof(integer_t)));  // row indices
-      if (partition_type == MsgType::Request_Add)
-        vec.push_back(Blob(count[i] * row_size_));  // row values
+  if (std::is_sorted(dest.begin(), dest.end())) {
+    // rows of each server are contiguous, send views of them
+    integer_t begin = 0;
+    for (auto i = 0; i < num_server_; i++) {
+      if (count[i] == 0) continue;
+      std::vector<Blob>& vec = (*out)[MV_ServerIdToRank(i)];
+      vec.push_back(Blob(kv[0], begin * sizeof(integer_t),
+        count[i] * sizeof(integer_t)));  // row indices
+      if (partition_type == MsgType::Request_Add) {
+        vec.push_back(Blob(kv[1], begin * row_size_,
+          count[i] * row_size_));  // row values
+      }
+      begin += count[i];
     }
-  }
-  count.clear();
-  count.resize(num_server_, 0);
+  } else {
+    for (auto i = 0; i < num_server_; i++) {  // allocate memory for blobs
+      int rank = MV_ServerIdToRank(i);
+      if (count[i] != 0) {
+        std::vector<Blob>& vec = (*out)[rank];
+        vec.push_back(Blob(count[i] * sizeof(integer_t)));  // row indices
+        if (partition_type == MsgType::Request_Add)
+          vec.push_back(Blob(count[i] * row_size_));  // row values
+      }
+    }
+    count.clear();
+    count.resize(num_server_, 0);
 
-  integer_t offset = 0;
-  for (auto i = 0; i < keys_size; ++i) {
-    int dst = dest[i];
-    int rank = MV_ServerIdToRank(dst);
-    (*out)[rank][0].As<integer_t>(count[dst]) = keys[i];
-    if (partition_type == MsgType::Request_Add) { // copy add values
-      memcpy(&((*out)[rank][1].As<T>(count[dst] * num_col_)),
-        kv[1].data() + offset, row_size_);
-      offset += row_size_;
+    integer_t offset = 0;
+    for (auto i = 0; i < keys_size; ++i) {
+      int dst = dest[i];
+      int rank = MV_ServerIdToRank(dst);
+      (*out)[rank][0].As<integer_t>(count[dst]) = keys[i];
+      if (partition_type == MsgType::Request_Add) { // copy add values
+        memcpy(&((*out)[rank][1].As<T>(count[dst] * num_col_)),
+          kv[1].data() + offset, row_size_);
+        offset += row_size_;
+      }
+      ++count[dst];
     }
-    ++count[dst];
   }
 
   for (int i = 0; i < num_server_; ++i) {
@@ -334,46 +356,61 @@ int MatrixWorker<T>::Partition(const std::vector<Blob>& kv,
     }
   }
 
-  if (partition_type == MsgType::Request_Get) {
-    CHECK(get_reply_count_ == 0);
-    get_reply_count_ = static_cast<int>(out->size());
-  }
-
   // TODO(qiwye): adding logic for filtering
   return static_cast<int>(out->size());
 }
 
 template <typename T>
-void MatrixWorker<T>::ProcessReplyGet(std::vector<Blob>& reply_data) {
+int MatrixWorker<T>::StartGet(Blob keys, RowIndex<T> row_index,
+                              const GetOption* option) {
+  int id = NewOp(nullptr);
+  {
+    // set before the replies may come
+    std::lock_guard<std::mutex> lock(*row_indexes_mutex_);
+    row_indexes_.emplace(id, std::move(row_index));
+  }
+  SendGet(id, keys, option);
+  return id;
+}
+
+template <typename T>
+void MatrixWorker<T>::ProcessReplyGet(std::vector<Blob>& reply_data,
+                                      int msg_id) {
+  RowIndex<T>* row_index;
+  {
+    // other threads may start Gets meanwhile, which leaves row_index in place
+    std::lock_guard<std::mutex> lock(*row_indexes_mutex_);
+    auto it = row_indexes_.find(msg_id);
+    CHECK(it != row_indexes_.end());
+    row_index = &it->second;
+  }
+
   size_t keys_size = reply_data[0].size<integer_t>();
   integer_t* keys = reinterpret_cast<integer_t*>(reply_data[0].data());
   T* data = reinterpret_cast<T*>(reply_data[1].data());
 
-  if (is_sparse_) {
-    if (row_index_[num_row_] != nullptr) {
-      for (auto i = 0; i < keys_size; ++i) {
-        row_index_[keys[i]] = row_index_[num_row_] + keys[i] * num_col_;
-      }
-    }
-  }
   // get all rows, only happen in T*
   if (keys_size == 1 && keys[0] == -1) {
     int server_id = reply_data[2].As<int>();
-    CHECK_NOTNULL(row_index_[num_row_]);
+    CHECK_NOTNULL(row_index->whole_table());
     CHECK(server_id < server_offsets_.size() - 1);
-    memcpy(row_index_[num_row_] + server_offsets_[server_id] * num_col_,
+    memcpy(row_index->whole_table() + server_offsets_[server_id] * num_col_,
       data, reply_data[1].size());
   }
   else {
     CHECK(reply_data[1].size() == keys_size * row_size_);
     integer_t offset = 0;
     for (auto i = 0; i < keys_size; ++i) {
-      CHECK_NOTNULL(row_index_[keys[i]]);
-      memcpy(row_index_[keys[i]], data + offset, row_size_);
+      memcpy(row_index->Get(keys[i]), data + offset, row_size_);
       offset += num_col_;
     }
   }
-  --get_reply_count_;
+}
+
+template <typename T>
+void MatrixWorker<T>::ProcessDone(int msg_id) {
+  std::lock_guard<std::mutex> lock(*row_indexes_mutex_);
+  row_indexes_.erase(msg_id);
 }
 
 template <typename T>
@@ -400,7 +437,7 @@ MatrixServer<T>::MatrixServer(integer_t num_row, integer_t num_col,
   }
   my_num_row_ = size;
   storage_.resize(my_num_row_ * num_col);
-  updater_ = Updater<T>::GetUpdater(my_num_row_ * num_col);
+  updater_ = Updater<T>::GetUpdater(my_num_row_ * num_col, num_col);
   Log::Info("[Init] Server =  %d, type = matrixTable, size =  [ %d x %d ], total =  [ %d x %d ].\n",
     server_id_, size, num_col, num_row, num_col);
 
@@ -444,13 +481,13 @@ void MatrixServer<T>::ProcessAdd(const std::vector<Blob>& data) {
   else {
     CHECK(data[1].size() == keys_size * sizeof(T) * num_col_);
 
-    integer_t offset_v = 0;
     CHECK(storage_.size() >= keys_size * num_col_);
+    std::vector<size_t> offsets(keys_size);
     for (auto i = 0; i < keys_size; ++i) {
-      integer_t offset_s = (keys[i] - row_offset_) * num_col_;
-      updater_->Update(num_col_, storage_.data(), values + offset_v, option, offset_s);
-      offset_v += num_col_;
+      offsets[i] = (keys[i] - row_offset_) * num_col_;
     }
+    updater_->UpdateRows(offsets.data(), static_cast<int>(keys_size),
+                         num_col_, storage_.data(), values, option);
     Log::Debug("[ProcessAdd] Server = %d, adding #rows = %d\n",
       server_id_, keys_size);
   }
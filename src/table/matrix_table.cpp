@@ -1,5 +1,8 @@
 #include "multiverso/table/matrix_table.h"
 
+#include <algorithm>
+#include <mutex>
+#include <utility>
 #include <vector>
 
 #include "multiverso/io/io.h"
@@ -12,47 +15,25 @@ namespace multiverso {
 
 template <typename T>
 MatrixWorkerTable<T>::MatrixWorkerTable(const MatrixTableOption<T>& option) :
-MatrixWorkerTable(option.num_row, option.num_col) {}
+MatrixWorkerTable(option.num_row, option.num_col, option.partition) {}
 
 template <typename T>
-MatrixWorkerTable<T>::MatrixWorkerTable(integer_t num_row, integer_t num_col) :
-  WorkerTable(), num_row_(num_row), num_col_(num_col) {
+MatrixWorkerTable<T>::MatrixWorkerTable(integer_t num_row, integer_t num_col,
+                                        RowPartition partition) :
+  WorkerTable(), num_row_(num_row), num_col_(num_col),
+  partitioner_(partition, num_row, MV_NumServers()) {
   row_size_ = num_col * sizeof(T);
-  get_reply_count_ = 0;
-
-  num_server_ = MV_NumServers();
-  //  compute row offsets in all servers
-  server_offsets_.push_back(0);
-  integer_t length = num_row / num_server_;
-  integer_t offset = length;
-  if (length > 0) {
-    int i = 0;
-    while (length > 0 && offset < num_row && ++i < num_server_) {
-      server_offsets_.push_back(offset);
-      offset += length;
-    }
-    server_offsets_.push_back(num_row);
-  } else {
-    int i = 0;
-    offset += 1;
-    while (offset < num_row && ++i < num_server_) {
-      server_offsets_.push_back(offset);
-      offset += 1;
-    }
-    server_offsets_.push_back(num_row);
-  }
+  row_indexes_mutex_ = new std::mutex();
   // using actual number of servers
-  num_server_ = static_cast<int>(server_offsets_.size() - 1);
+  num_server_ = partitioner_.num_server();
 
   Log::Debug("[Init] worker =  %d, type = matrixTable, size =  [ %d x %d ].\n",
     MV_Rank(), num_row, num_col);
-  row_index_ = new T*[num_row_ + 1];
 }
 
 template <typename T>
 MatrixWorkerTable<T>::~MatrixWorkerTable() {
-  server_offsets_.clear();
-  delete[]row_index_;
+  delete row_indexes_mutex_;
 }
 
 template <typename T>
@@ -64,14 +45,7 @@ void MatrixWorkerTable<T>::Get(T* data, size_t size) {
 
 template <typename T>
 void MatrixWorkerTable<T>::Get(integer_t row_id, T* data, size_t size) {
-  if (row_id >= 0) CHECK(size == num_col_);
-  for (auto i = 0; i < num_row_ + 1; ++i) row_index_[i] = nullptr;
-  if (row_id == -1) {
-    row_index_[num_row_] = data;
-  } else {
-    row_index_[row_id] = data;  // data_ = data;
-  }
-  WorkerTable::Get(Blob(&row_id, sizeof(integer_t)));
+  Wait(GetAsync(row_id, data, size));
   Log::Debug("[Get] worker = %d, #row = %d\n", MV_Rank(), row_id);
 }
 
@@ -79,26 +53,14 @@ template <typename T>
 void MatrixWorkerTable<T>::Get(const std::vector<integer_t>& row_ids,
   const std::vector<T*>& data_vec,
   size_t size) {
-  CHECK(size == num_col_);
-  CHECK(row_ids.size() == data_vec.size());
-  for (auto i = 0; i < num_row_ + 1; ++i) row_index_[i] = nullptr;
-  for (auto i = 0; i < row_ids.size(); ++i) {
-    row_index_[row_ids[i]] = data_vec[i];
-  }
-  WorkerTable::Get(Blob(row_ids.data(), sizeof(integer_t)* row_ids.size()));
+  Wait(GetAsync(row_ids, data_vec, size));
   Log::Debug("[Get] worker = %d, #rows_set = %d\n", MV_Rank(), row_ids.size());
 }
 
 template <typename T>
 void MatrixWorkerTable<T>::Get(T* data, size_t size, integer_t* row_ids,
   integer_t row_ids_size) {
-  CHECK(size == num_col_ * row_ids_size);
-  for (auto i = 0; i < num_row_ + 1; ++i) row_index_[i] = nullptr;
-  for (auto i = 0; i < row_ids_size; ++i) {
-    row_index_[row_ids[i]] = &data[i * num_col_];
-  }
-  Blob ids_blob(row_ids, sizeof(integer_t) * row_ids_size);
-  WorkerTable::Get(ids_blob);
+  Wait(GetAsync(data, size, row_ids, row_ids_size));
   Log::Debug("[Get] worker = %d, #rows_set = %d\n", MV_Rank(), row_ids_size);
 }
 
@@ -113,8 +75,9 @@ template <typename T>
 void MatrixWorkerTable<T>::Add(integer_t row_id, T* data, size_t size,
                                               const AddOption* option) {
   if (row_id >= 0) CHECK(size == num_col_);
-  Blob ids_blob(&row_id, sizeof(integer_t));
-  Blob data_blob(data, size * sizeof(T));
+  // data is not touched until the Add is done, no need to copy
+  Blob ids_blob = Blob::Wrap(&row_id, sizeof(integer_t));
+  Blob data_blob = Blob::Wrap(data, size * sizeof(T));
   WorkerTable::Add(ids_blob, data_blob, option);
   Log::Debug("[Add] worker = %d, #row = %d\n", MV_Rank(), row_id);
 }
@@ -125,7 +88,8 @@ void MatrixWorkerTable<T>::Add(const std::vector<integer_t>& row_ids,
                                size_t size,
                                const AddOption* option) {
   CHECK(size == num_col_);
-  Blob ids_blob(&row_ids[0], sizeof(integer_t)* row_ids.size());
+  Blob ids_blob = Blob::Wrap(const_cast<integer_t*>(row_ids.data()),
+                             sizeof(integer_t)* row_ids.size());
   Blob data_blob(row_ids.size() * row_size_);
   // copy each row
   for (auto i = 0; i < row_ids.size(); ++i) {
@@ -140,8 +104,8 @@ void MatrixWorkerTable<T>::Add(T* data, size_t size, integer_t* row_ids,
   integer_t row_ids_size,
   const AddOption* option) {
   CHECK(size == num_col_ * row_ids_size);
-  Blob ids_blob(row_ids, sizeof(integer_t) * row_ids_size);
-  Blob data_blob(data, row_ids_size * row_size_);
+  Blob ids_blob = Blob::Wrap(row_ids, sizeof(integer_t) * row_ids_size);
+  Blob data_blob = Blob::Wrap(data, row_ids_size * row_size_);
   WorkerTable::Add(ids_blob, data_blob, option);
   Log::Debug("[Add] worker = %d, #rows_set = %d\n", MV_Rank(), row_ids_size);
 }
@@ -156,13 +120,13 @@ int MatrixWorkerTable<T>::GetAsync(T* data, size_t size) {
 template <typename T>
 int MatrixWorkerTable<T>::GetAsync(integer_t row_id, T* data, size_t size) {
   if (row_id >= 0) CHECK(size == num_col_);
-  for (auto i = 0; i < num_row_ + 1; ++i) row_index_[i] = nullptr;
+  RowIndex<T> row_index(num_col_);
   if (row_id == -1) {
-    row_index_[num_row_] = data;
+    row_index.SetWholeTable(data);
   } else {
-    row_index_[row_id] = data;  // data_ = data;
+    row_index.Set(row_id, data);
   }
-  return WorkerTable::GetAsync(Blob(&row_id, sizeof(integer_t)));
+  return StartGet(Blob(&row_id, sizeof(integer_t)), std::move(row_index));
 }
 
 template <typename T>
@@ -171,23 +135,39 @@ int MatrixWorkerTable<T>::GetAsync(const std::vector<integer_t>& row_ids,
   size_t size) {
   CHECK(size == num_col_);
   CHECK(row_ids.size() == data_vec.size());
-  for (auto i = 0; i < num_row_ + 1; ++i) row_index_[i] = nullptr;
+  RowIndex<T> row_index(num_col_);
+  row_index.Reserve(row_ids.size());
   for (auto i = 0; i < row_ids.size(); ++i) {
-    row_index_[row_ids[i]] = data_vec[i];
+    row_index.Set(row_ids[i], data_vec[i]);
   }
-  return WorkerTable::GetAsync(Blob(row_ids.data(), sizeof(integer_t)* row_ids.size()));
+  return StartGet(Blob(row_ids.data(), sizeof(integer_t)* row_ids.size()),
+                  std::move(row_index));
 }
 
 template <typename T>
 int MatrixWorkerTable<T>::GetAsync(T* data, size_t size, integer_t* row_ids,
   integer_t row_ids_size) {
   CHECK(size == num_col_ * row_ids_size);
-  for (auto i = 0; i < num_row_ + 1; ++i) row_index_[i] = nullptr;
+  RowIndex<T> row_index(num_col_);
+  row_index.Reserve(row_ids_size);
   for (auto i = 0; i < row_ids_size; ++i) {
-    row_index_[row_ids[i]] = &data[i * num_col_];
+    row_index.Set(row_ids[i], &data[i * num_col_]);
   }
   Blob ids_blob(row_ids, sizeof(integer_t) * row_ids_size);
-  return WorkerTable::GetAsync(ids_blob);
+  return StartGet(ids_blob, std::move(row_index));
+}
+
+template <typename T>
+int MatrixWorkerTable<T>::StartGet(Blob keys, RowIndex<T> row_index,
+                                   const GetOption* option) {
+  int id = NewOp(nullptr);
+  {
+    // set before the replies may come
+    std::lock_guard<std::mutex> lock(*row_indexes_mutex_);
+    row_indexes_.emplace(id, std::move(row_index));
+  }
+  SendGet(id, keys, option);
+  return id;
 }
 
 template <typename T>
@@ -249,16 +229,26 @@ int MatrixWorkerTable<T>::Partition(const std::vector<Blob>& kv,
     if (kv.size() >= 2) {  // process add values
       for (integer_t i = 0; i < num_server_; ++i){
         int rank = MV_ServerIdToRank(i);
-        Blob blob(kv[1].data() + server_offsets_[i] * row_size_,
-          (server_offsets_[i + 1] - server_offsets_[i]) * row_size_);
+        integer_t num_rows = partitioner_.NumRows(i);
+        Blob blob;
+        if (partitioner_.contiguous()) {
+          blob = Blob(kv[1], static_cast<size_t>(partitioner_.Offset(i)) *
+                      row_size_, static_cast<size_t>(num_rows) * row_size_);
+        } else {
+          // gather the rows of server i in their physical order
+          blob = Blob(static_cast<size_t>(num_rows) * row_size_);
+          for (integer_t j = 0; j < num_rows; ++j) {
+            memcpy(blob.data() + static_cast<size_t>(j) * row_size_,
+              kv[1].data() +
+              static_cast<size_t>(partitioner_.GlobalRow(i, j)) * row_size_,
+              row_size_);
+          }
+        }
         (*out)[rank].push_back(blob);
         if (kv.size() == 3) {  // update option blob
           (*out)[rank].push_back(kv[2]);
         }
       }
-    } else {
-      CHECK(get_reply_count_ == 0);
-      get_reply_count_ = static_cast<int>(out->size());
     }
     return static_cast<int>(out->size());
   }
@@ -267,35 +257,52 @@ int MatrixWorkerTable<T>::Partition(const std::vector<Blob>& kv,
   std::vector<int> dest;
   std::vector<integer_t> count;
   count.resize(num_server_, 0);
-  integer_t num_row_each = num_row_ / num_server_;
   for (auto i = 0; i < keys_size; ++i){
-    int dst = keys[i] / num_row_each;
-    dst = (dst >= num_server_ ? num_server_ - 1 : dst);
+    int dst = partitioner_.ServerOf(keys[i]);
     dest.push_back(dst);
     ++count[dst];
   }
-  for (auto i = 0; i < num_server_; i++) { // allocate memory for blobs
-    int rank = MV_ServerIdToRank(i);
-    if (count[i] != 0) {
-      std::vector<Blob>& vec = (*out)[rank];
-      vec.push_back(Blob(count[i] * sizeof(integer_t)));
-      if (kv.size() >= 2) vec.push_back(Blob(count[i] * row_size_));
+  if (std::is_sorted(dest.begin(), dest.end())) {
+    // rows of each server are contiguous, send views of them
+    integer_t begin = 0;
+    for (auto i = 0; i < num_server_; i++) {
+      if (count[i] == 0) continue;
+      std::vector<Blob>& vec = (*out)[MV_ServerIdToRank(i)];
+      vec.push_back(Blob(kv[0], begin * sizeof(integer_t),
+        count[i] * sizeof(integer_t)));
+      if (kv.size() >= 2) {
+        vec.push_back(Blob(kv[1], static_cast<size_t>(begin) * row_size_,
+                           static_cast<size_t>(count[i]) * row_size_));
+      }
+      begin += count[i];
     }
-  }
-  count.clear();
-  count.resize(num_server_, 0);
+  } else {
+    for (auto i = 0; i < num_server_; i++) { // allocate memory for blobs
+      int rank = MV_ServerIdToRank(i);
+      if (count[i] != 0) {
+        std::vector<Blob>& vec = (*out)[rank];
+        vec.push_back(Blob(count[i] * sizeof(integer_t)));
+        if (kv.size() >= 2) {
+          vec.push_back(Blob(static_cast<size_t>(count[i]) * row_size_));
+        }
+      }
+    }
+    count.clear();
+    count.resize(num_server_, 0);
 
-  integer_t offset = 0;
-  for (auto i = 0; i < keys_size; ++i) {
-    int dst = dest[i];
-    int rank = MV_ServerIdToRank(dst);
-    (*out)[rank][0].As<integer_t>(count[dst]) = keys[i];
-    if (kv.size() >= 2){ // copy add values
-      memcpy(&((*out)[rank][1].As<T>(count[dst] * num_col_)),
-        kv[1].data() + offset, row_size_);
-      offset += row_size_;
+    size_t offset = 0;
+    for (auto i = 0; i < keys_size; ++i) {
+      int dst = dest[i];
+      int rank = MV_ServerIdToRank(dst);
+      (*out)[rank][0].As<integer_t>(count[dst]) = keys[i];
+      if (kv.size() >= 2){ // copy add values
+        memcpy(&((*out)[rank][1].As<T>(
+          static_cast<size_t>(count[dst]) * num_col_)),
+          kv[1].data() + offset, row_size_);
+        offset += row_size_;
+      }
+      ++count[dst];
     }
-    ++count[dst];
   }
   for (int i = 0; i < num_server_; ++i){
     int rank = MV_ServerIdToRank(i);
@@ -306,17 +313,23 @@ int MatrixWorkerTable<T>::Partition(const std::vector<Blob>& kv,
     }
   }
 
-  if (kv.size() == 1){
-    CHECK(get_reply_count_ == 0);
-    get_reply_count_ = static_cast<int>(out->size());
-  }
   return static_cast<int>(out->size());
 }
 
 template <typename T>
-void MatrixWorkerTable<T>::ProcessReplyGet(std::vector<Blob>& reply_data) {
+void MatrixWorkerTable<T>::ProcessReplyGet(std::vector<Blob>& reply_data,
+                                           int msg_id) {
   CHECK(reply_data.size() == 2 || reply_data.size() == 3); //3 for get all rows
 
+  RowIndex<T>* row_index;
+  {
+    // other threads may start Gets meanwhile, which leaves row_index in place
+    std::lock_guard<std::mutex> lock(*row_indexes_mutex_);
+    auto it = row_indexes_.find(msg_id);
+    CHECK(it != row_indexes_.end());
+    row_index = &it->second;
+  }
+
   size_t keys_size = reply_data[0].size<integer_t>();
   integer_t* keys = reinterpret_cast<integer_t*>(reply_data[0].data());
   T* data = reinterpret_cast<T*>(reply_data[1].data());
@@ -324,53 +337,61 @@ void MatrixWorkerTable<T>::ProcessReplyGet(std::vector<Blob>& reply_data) {
   //get all rows, only happen in T*
   if (keys_size == 1 && keys[0] == -1) {
     int server_id = reply_data[2].As<int>();
-    CHECK_NOTNULL(row_index_[num_row_]);
-    CHECK(server_id < server_offsets_.size() - 1);
-    memcpy(row_index_[num_row_] + server_offsets_[server_id] * num_col_,
-      data, reply_data[1].size());
+    CHECK_NOTNULL(row_index->whole_table());
+    CHECK(server_id < num_server_);
+    CHECK(reply_data[1].size() ==
+          static_cast<size_t>(partitioner_.NumRows(server_id)) * row_size_);
+    if (partitioner_.contiguous()) {
+      memcpy(row_index->whole_table() +
+        static_cast<size_t>(partitioner_.Offset(server_id)) * num_col_,
+        data, reply_data[1].size());
+    } else {
+      for (integer_t i = 0; i < partitioner_.NumRows(server_id); ++i) {
+        memcpy(row_index->whole_table() +
+          static_cast<size_t>(partitioner_.GlobalRow(server_id, i)) * num_col_,
+          data + static_cast<size_t>(i) * num_col_, row_size_);
+      }
+    }
   } else {
     CHECK(reply_data[1].size() == keys_size * row_size_);
     integer_t offset = 0;
     for (auto i = 0; i < keys_size; ++i) {
-      CHECK_NOTNULL(row_index_[keys[i]]);
-      memcpy(row_index_[keys[i]], data + offset, row_size_);
+      memcpy(row_index->Get(keys[i]), data + offset, row_size_);
       offset += num_col_;
     }
   }
-  --get_reply_count_;
+}
+
+template <typename T>
+void MatrixWorkerTable<T>::ProcessDone(int msg_id) {
+  std::lock_guard<std::mutex> lock(*row_indexes_mutex_);
+  row_indexes_.erase(msg_id);
 }
 
 template <typename T>
 MatrixServerTable<T>::MatrixServerTable(const MatrixTableOption<T>& option) :
-MatrixServerTable(option.num_row, option.num_col) {}
+MatrixServerTable(option.num_row, option.num_col, option.partition) {}
 
 template <typename T>
-MatrixServerTable<T>::MatrixServerTable(integer_t num_row, integer_t num_col) :
-  ServerTable(), num_col_(num_col) {
+MatrixServerTable<T>::MatrixServerTable(integer_t num_row, integer_t num_col,
+                                        RowPartition partition) :
+  ServerTable(), num_col_(num_col),
+  partitioner_(partition, num_row, MV_NumServers()) {
 
   server_id_ = MV_ServerId();
   CHECK(server_id_ != -1);
 
-  integer_t size = num_row / MV_NumServers();
-  if (size > 0) {
-    row_offset_ = size * server_id_; // Zoo::Get()->rank();
-    if (server_id_ == MV_NumServers() - 1) {
-      size = num_row - row_offset_;
-    }
-  } else {
-    size = server_id_ < num_row ? 1 : 0;
-    row_offset_ = server_id_;
-  }
-  my_num_row_ = size;
+  my_num_row_ = partitioner_.NumRows(server_id_);
   storage_.resize(my_num_row_ * num_col);
-  updater_ = Updater<T>::GetUpdater(my_num_row_ * num_col);
+  updater_ = Updater<T>::GetUpdater(my_num_row_ * num_col, num_col);
   Log::Debug("[Init] Server =  %d, type = matrixTable, size =  [ %d x %d ], total =  [ %d x %d ].\n",
-    server_id_, size, num_col, num_row, num_col);
+    server_id_, my_num_row_, num_col, num_row, num_col);
 }
 
 template <typename T>
-MatrixServerTable<T>::MatrixServerTable(integer_t num_row, integer_t num_col, float min_value,float max_value) :
-MatrixServerTable<T>::MatrixServerTable(num_row, num_col) {
+MatrixServerTable<T>::MatrixServerTable(integer_t num_row, integer_t num_col, float min_value,float max_value,
+                                        RowPartition partition) :
+MatrixServerTable<T>::MatrixServerTable(num_row, num_col, partition) {
   if (typeid(T) == typeid(float)){
     std::random_device rd;
     std::mt19937 gen(rd());
@@ -385,6 +406,12 @@ MatrixServerTable<T>::MatrixServerTable(num_row, num_col) {
 
 template <typename T>
 void MatrixServerTable<T>::ProcessAdd(const std::vector<Blob>& data) {
+  AddRows(data, 0, 1);
+}
+
+template <typename T>
+void MatrixServerTable<T>::AddRows(const std::vector<Blob>& data,
+                                   int shard, int num_shards) {
   CHECK(data.size() == 2 || data.size() == 3);
   size_t keys_size = data[0].size<integer_t>();
   integer_t* keys = reinterpret_cast<integer_t*>(data[0].data());
@@ -397,27 +424,113 @@ void MatrixServerTable<T>::ProcessAdd(const std::vector<Blob>& data) {
   if (keys_size == 1 && keys[0] == -1){
     size_t ssize = storage_.size();
     CHECK(ssize == data[1].size<T>());
-    updater_->Update(ssize, storage_.data(), values, option);
-    Log::Debug("[ProcessAdd] Server = %d, adding all rows offset = %d, #rows = %d\n",
-      server_id_, row_offset_, ssize / num_col_);
+    size_t begin = std::min<size_t>(ssize, static_cast<size_t>(
+      ShardRows(num_shards)) * shard * num_col_);
+    size_t end = std::min<size_t>(ssize, static_cast<size_t>(
+      ShardRows(num_shards)) * (shard + 1) * num_col_);
+    updater_->Update(end - begin, storage_.data(), values + begin, option,
+                     begin);
+    Log::Debug("[ProcessAdd] Server = %d, adding all rows, #rows = %d\n",
+      server_id_, (end - begin) / num_col_);
   } else {
     CHECK(data[1].size() == keys_size * sizeof(T) * num_col_);
 
-    integer_t offset_v = 0;
     CHECK(storage_.size() >= keys_size * num_col_);
+    // with several shards, the deltas of the rows of this one are copied
+    // together for UpdateRows
+    std::vector<size_t> offsets;
+    std::vector<T> deltas;
+    offsets.reserve(keys_size);
     for (auto i = 0; i < keys_size; ++i) {
-      integer_t offset_s = (keys[i] - row_offset_) * num_col_;
-      updater_->Update(num_col_, storage_.data(), values + offset_v, option, offset_s);
-      offset_v += num_col_;
+      integer_t row = partitioner_.LocalRow(keys[i]);
+      if (num_shards > 1) {
+        if (row / ShardRows(num_shards) != shard) continue;
+        deltas.insert(deltas.end(), values + static_cast<size_t>(i) * num_col_,
+                      values + static_cast<size_t>(i + 1) * num_col_);
+      }
+      offsets.push_back(static_cast<size_t>(row) * num_col_);
     }
+    updater_->UpdateRows(offsets.data(), static_cast<int>(offsets.size()),
+                         num_col_, storage_.data(),
+                         num_shards > 1 ? deltas.data() : values, option);
     Log::Debug("[ProcessAdd] Server = %d, adding #rows = %d\n",
-      server_id_, keys_size);
+      server_id_, offsets.size());
   }
   delete option;
 }
 
+template <typename T>
+void MatrixServerTable<T>::ProcessAdds(
+  const std::vector<const std::vector<Blob>*>& adds) {
+  AddShard(adds, 0, 1);
+}
+
+template <typename T>
+void MatrixServerTable<T>::AddShard(
+  const std::vector<const std::vector<Blob>*>& adds,
+  int shard, int num_shards) {
+  bool combine = updater_->Linear() && adds.size() > 1;
+  size_t num_rows = 0;
+  for (auto data : adds) {
+    integer_t* keys = reinterpret_cast<integer_t*>((*data)[0].data());
+    size_t keys_size = (*data)[0].size<integer_t>();
+    // whole table Adds are applied as they are
+    combine = combine && !(keys_size == 1 && keys[0] == -1);
+    num_rows += keys_size;
+  }
+  if (!combine) {
+    for (auto data : adds) AddRows(*data, shard, num_shards);
+    return;
+  }
+
+  // rows of the shard in order, the deltas of a row in the order of the Adds
+  std::vector<std::pair<integer_t, T*>> rows;
+  rows.reserve(num_rows);
+  for (auto data : adds) {
+    CHECK((*data)[1].size() == (*data)[0].size<integer_t>() * sizeof(T) * num_col_);
+    integer_t* keys = reinterpret_cast<integer_t*>((*data)[0].data());
+    T* values = reinterpret_cast<T*>((*data)[1].data());
+    for (size_t i = 0; i < (*data)[0].size<integer_t>(); ++i) {
+      integer_t row = partitioner_.LocalRow(keys[i]);
+      if (row / ShardRows(num_shards) != shard) continue;
+      rows.emplace_back(row, values + i * num_col_);
+    }
+  }
+  std::stable_sort(rows.begin(), rows.end(),
+    [](const std::pair<integer_t, T*>& a, const std::pair<integer_t, T*>& b) {
+      return a.first < b.first;
+    });
+
+  // the sum of the deltas of each row, one after another, for UpdateRows
+  std::vector<size_t> offsets;
+  std::vector<T> sums;
+  sums.reserve(rows.size() * num_col_);
+  for (size_t i = 0; i < rows.size();) {
+    size_t end = i + 1;
+    while (end < rows.size() && rows[end].first == rows[i].first) ++end;
+    sums.insert(sums.end(), rows[i].second, rows[i].second + num_col_);
+    T* sum = sums.data() + sums.size() - num_col_;
+    for (size_t j = i + 1; j < end; ++j) {
+      for (integer_t k = 0; k < num_col_; ++k) sum[k] += rows[j].second[k];
+    }
+    offsets.push_back(static_cast<size_t>(rows[i].first) * num_col_);
+    i = end;
+  }
+  updater_->UpdateRows(offsets.data(), static_cast<int>(offsets.size()),
+                       num_col_, storage_.data(), sums.data());
+  Log::Debug("[ProcessAdds] Server = %d, adding #rows = %d of %d Adds\n",
+    server_id_, rows.size(), adds.size());
+}
+
 template <typename T>
 void MatrixServerTable<T>::ProcessGet(const std::vector<Blob>& data,
+  std::vector<Blob>* result) {
+  PrepareGet(data, result);
+  GetShard(data, result, 0, 1);
+}
+
+template <typename T>
+void MatrixServerTable<T>::PrepareGet(const std::vector<Blob>& data,
   std::vector<Blob>* result) {
   CHECK(data.size() == 1);
   CHECK_NOTNULL(result);
@@ -429,28 +542,42 @@ void MatrixServerTable<T>::ProcessGet(const std::vector<Blob>& data,
 
   //get all rows
   if (keys_size == 1 && keys[0] == -1){
-    Blob value(sizeof(T) * storage_.size());
-    T* pvalues = reinterpret_cast<T*>(value.data());
-    updater_->Access(storage_.size(), storage_.data(), pvalues);
-    result->push_back(value);
+    result->push_back(Blob(sizeof(T) * storage_.size()));
     result->push_back(Blob(&server_id_, sizeof(int)));
-    Log::Debug("[ProcessGet] Server = %d, getting all rows offset = %d, #rows = %d\n",
-      server_id_, row_offset_, storage_.size() / num_col_);
     return;
   }
+  result->push_back(Blob(keys_size * sizeof(T) * num_col_));
+}
 
-  integer_t row_size = sizeof(T)* num_col_;
-  result->push_back(Blob(keys_size * row_size));
+template <typename T>
+void MatrixServerTable<T>::GetShard(const std::vector<Blob>& data,
+  std::vector<Blob>* result, int shard, int num_shards) {
+  size_t keys_size = data[0].size<integer_t>();
+  integer_t* keys = reinterpret_cast<integer_t*>(data[0].data());
   T* vals = reinterpret_cast<T*>((*result)[1].data());
-  integer_t offset_v = 0;
+
+  //get all rows
+  if (keys_size == 1 && keys[0] == -1){
+    size_t ssize = storage_.size();
+    size_t begin = std::min<size_t>(ssize, static_cast<size_t>(
+      ShardRows(num_shards)) * shard * num_col_);
+    size_t end = std::min<size_t>(ssize, static_cast<size_t>(
+      ShardRows(num_shards)) * (shard + 1) * num_col_);
+    updater_->Access(end - begin, storage_.data(), vals + begin, begin);
+    Log::Debug("[ProcessGet] Server = %d, getting all rows, #rows = %d\n",
+      server_id_, (end - begin) / num_col_);
+    return;
+  }
+
   for (auto i = 0; i < keys_size; ++i) {
-    integer_t offset_s = (keys[i] - row_offset_) * num_col_;
-    updater_->Access(num_col_, storage_.data(), vals + offset_v, offset_s);
-    offset_v += num_col_;
+    integer_t row = partitioner_.LocalRow(keys[i]);
+    if (num_shards > 1 && row / ShardRows(num_shards) != shard) continue;
+    updater_->Access(num_col_, storage_.data(),
+                     vals + static_cast<size_t>(i) * num_col_,
+                     static_cast<size_t>(row) * num_col_);
   }
   Log::Debug("[ProcessGet] Server = %d, getting row #rows = %d\n",
     server_id_, keys_size);
-  return;
 }
 
 template <typename T>
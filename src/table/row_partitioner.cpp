@@ -0,0 +1,113 @@
+#include "multiverso/table/row_partitioner.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+#include "multiverso/util/configure.h"
+#include "multiverso/util/log.h"
+
+namespace multiverso {
+
+MV_DEFINE_string(matrix_partition, "contiguous", "how the rows of matrix "
+                 "tables are spread over servers: contiguous, interleaved "
+                 "or hashed");
+
+namespace {
+
+int HashRow(integer_t row, int num_server) {
+  // finalizer of murmur3, mixes neighbouring rows apart
+  uint32_t h = static_cast<uint32_t>(row);
+  h ^= h >> 16;
+  h *= 0x85ebca6b;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35;
+  h ^= h >> 16;
+  return static_cast<int>(h % static_cast<uint32_t>(num_server));
+}
+
+}  // namespace
+
+RowPartition DefaultRowPartition() {
+  const std::string& mode = MV_CONFIG_matrix_partition;
+  if (mode == "contiguous") return RowPartition::kContiguous;
+  if (mode == "interleaved") return RowPartition::kInterleaved;
+  if (mode == "hashed") return RowPartition::kHashed;
+  Log::Fatal("Unknown matrix_partition %s\n", mode.c_str());
+  return RowPartition::kContiguous;
+}
+
+RowPartitioner::RowPartitioner(RowPartition mode, integer_t num_row,
+                               int num_server) :
+  mode_(mode), num_row_(num_row) {
+  CHECK(num_row > 0 && num_server > 0);
+  num_server_ = std::min<integer_t>(num_server, num_row);
+  switch (mode_) {
+  case RowPartition::kContiguous: {
+    // the last server takes the rest
+    integer_t length = num_row / num_server_;
+    for (int i = 0; i < num_server_; ++i) offsets_.push_back(i * length);
+    offsets_.push_back(num_row);
+    break;
+  }
+  case RowPartition::kInterleaved:
+    break;
+  case RowPartition::kHashed:
+    rows_.resize(num_server_);
+    local_rows_.resize(num_row);
+    for (integer_t row = 0; row < num_row; ++row) {
+      std::vector<integer_t>& rows = rows_[HashRow(row, num_server_)];
+      local_rows_[row] = static_cast<integer_t>(rows.size());
+      rows.push_back(row);
+    }
+    break;
+  }
+}
+
+int RowPartitioner::ServerOf(integer_t row) const {
+  switch (mode_) {
+  case RowPartition::kContiguous:
+    return std::min<integer_t>(row / (num_row_ / num_server_),
+                               num_server_ - 1);
+  case RowPartition::kInterleaved:
+    return row % num_server_;
+  default:
+    return HashRow(row, num_server_);
+  }
+}
+
+integer_t RowPartitioner::NumRows(int server) const {
+  if (server >= num_server_) return 0;
+  switch (mode_) {
+  case RowPartition::kContiguous:
+    return offsets_[server + 1] - offsets_[server];
+  case RowPartition::kInterleaved:
+    return (num_row_ - server + num_server_ - 1) / num_server_;
+  default:
+    return static_cast<integer_t>(rows_[server].size());
+  }
+}
+
+integer_t RowPartitioner::LocalRow(integer_t row) const {
+  switch (mode_) {
+  case RowPartition::kContiguous:
+    return row - offsets_[ServerOf(row)];
+  case RowPartition::kInterleaved:
+    return row / num_server_;
+  default:
+    return local_rows_[row];
+  }
+}
+
+integer_t RowPartitioner::GlobalRow(int server, integer_t local) const {
+  switch (mode_) {
+  case RowPartition::kContiguous:
+    return offsets_[server] + local;
+  case RowPartition::kInterleaved:
+    return local * num_server_ + server;
+  default:
+    return rows_[server][local];
+  }
+}
+
+}  // namespace multiverso
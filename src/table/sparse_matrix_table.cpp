@@ -2,6 +2,7 @@
 #include "multiverso/table/sparse_matrix_table.h"
 #include <vector>
 #include <cctype>
+#include <utility>
 
 #include "multiverso/multiverso.h"
 #include "multiverso/util/log.h"
@@ -24,11 +25,11 @@ template <typename T>
 void SparseMatrixWorkerTable<T>::Get(integer_t row_id, T* data, size_t size,
   const GetOption* option) {
   if (row_id >= 0) CHECK(size == this->num_col_);
-  for (auto i = 0; i < this->num_row_ + 1; ++i) this->row_index_[i] = nullptr;
+  RowIndex<T> row_index(this->num_col_);
   if (row_id == -1) {
-    this->row_index_[this->num_row_] = data;
+    row_index.SetWholeTable(data);
   } else {
-    this->row_index_[row_id] = data; // data_ = data;
+    row_index.Set(row_id, data);
   }
   Blob keys(&row_id, sizeof(integer_t) * 1);
 
@@ -38,7 +39,7 @@ void SparseMatrixWorkerTable<T>::Get(integer_t row_id, T* data, size_t size,
     option = new GetOption();
   }
 
-  WorkerTable::Get(keys, option);
+  this->Wait(this->StartGet(keys, std::move(row_index), option));
   Log::Debug("[Get] worker = %d, #row = %d\n", MV_Rank(), row_id);
   if (is_option_mine) delete option;
 }
@@ -47,11 +48,12 @@ template <typename T>
 void SparseMatrixWorkerTable<T>::Get(const std::vector<integer_t>& row_ids,
   const std::vector<T*>& data_vec, size_t size, 
   const GetOption* option) {
-  for (auto i = 0; i < this->num_row_ + 1; ++i) this->row_index_[i] = nullptr;
   CHECK(size == this->num_col_);
   CHECK(row_ids.size() == data_vec.size());
+  RowIndex<T> row_index(this->num_col_);
+  row_index.Reserve(row_ids.size());
   for (integer_t i = 0; i < row_ids.size(); ++i) {
-    this->row_index_[row_ids[i]] = data_vec[i];
+    row_index.Set(row_ids[i], data_vec[i]);
   }
   Blob keys(row_ids.data(), sizeof(integer_t) * row_ids.size());
 
@@ -61,7 +63,7 @@ void SparseMatrixWorkerTable<T>::Get(const std::vector<integer_t>& row_ids,
     option = new GetOption();
   }
 
-  WorkerTable::Get(keys, option);
+  this->Wait(this->StartGet(keys, std::move(row_index), option));
   Log::Debug("[Get] worker = %d, #rows_set = %d\n", MV_Rank(),
     row_ids.size());
   if (is_option_mine) delete option;
@@ -91,8 +93,6 @@ int SparseMatrixWorkerTable<T>::Partition(const std::vector<Blob>& kv,
         }
       }
 
-      CHECK(this->get_reply_count_ == 0);
-      this->get_reply_count_ = static_cast<int>(out->size());
       res = static_cast<int>(out->size());
     } else {
       // count row number in each server
@@ -100,10 +100,8 @@ int SparseMatrixWorkerTable<T>::Partition(const std::vector<Blob>& kv,
       std::vector<integer_t> count;
       std::vector<int> dest;
       count.resize(this->num_server_, 0);
-      integer_t num_row_each = this->num_row_ / this->num_server_;  //  num_server_;
       for (auto i = 0; i < keys_size; ++i) {
-        int dst = keys[i] / num_row_each;
-        dst = (dst >= this->num_server_ ? this->num_server_ - 1 : dst);
+        int dst = this->partitioner_.ServerOf(keys[i]);
         dest.push_back(dst);
         ++count[dst];
       }
@@ -135,8 +133,6 @@ int SparseMatrixWorkerTable<T>::Partition(const std::vector<Blob>& kv,
         }
       }
 
-      CHECK(this->get_reply_count_ == 0);
-      this->get_reply_count_ = static_cast<int>(out->size());
       res = static_cast<int>(out->size());
     }
   } else {  // processing Add()
@@ -155,23 +151,6 @@ int SparseMatrixWorkerTable<T>::Partition(const std::vector<Blob>& kv,
   return res;
 }
 
-template <typename T>
-void SparseMatrixWorkerTable<T>::ProcessReplyGet(
-  std::vector<Blob>& reply_data) {
-  // replace row_index when original key == -1
-  if (this->row_index_[this->num_row_] != nullptr) {
-    size_t keys_size = reply_data[0].size<integer_t>();
-    Log::Debug("[SparseMatrixWorkerTable:ProcessReplyGet] worker = %d, #keys_size = %d\n", MV_Rank(),
-      keys_size);
-    integer_t* keys = reinterpret_cast<integer_t*>(reply_data[0].data());
-    for (auto i = 0; i < keys_size; ++i) {
-      this->row_index_[keys[i]] = this->row_index_[this->num_row_] + keys[i] * this->num_col_;
-    }
-  }
-
-  MatrixWorkerTable<T>::ProcessReplyGet(reply_data);
-}
-
 template <typename T>
 SparseMatrixServerTable<T>::~SparseMatrixServerTable() {
   for (auto i = 0; i < workers_nums_; ++i) {
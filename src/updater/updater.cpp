@@ -1,4 +1,9 @@
 #include "multiverso/updater/updater.h"
+
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 // TODO(qiwye) to make this a option in CMakelist
 //#define ENABLE_DCASGD
 
@@ -9,6 +14,7 @@
 #include "multiverso/updater/dcasgd/dcasgda_updater.h"
 #endif
 #include "multiverso/updater/sgd_updater.h"
+#include "multiverso/updater/updater_kernels.h"
 #include "multiverso/util/configure.h"
 #include "multiverso/util/log.h"
 
@@ -18,13 +24,68 @@ namespace multiverso {
 MV_DEFINE_string(updater_type, "default", "multiverso server updater type");
 MV_DEFINE_int(omp_threads, 4 , "#theads used by openMP for updater");
 
+namespace {
+// Elements a thread takes at least, fewer are added without openMP
+const int kBlock = 4096;
+// Rows prefetched ahead of the one updated
+const int kPrefetchRows = 4;
+}
+
 template <typename T>
 void Updater<T>::Update(size_t num_element, T* data, T* delta,
                         AddOption*, size_t offset) {
-  // parallelism with openMP
-  #pragma omp parallel for schedule(static) num_threads(MV_CONFIG_omp_threads)
-  for (int i = 0; i < num_element; ++i) {
-    data[i + offset] += delta[i];
+  // parallelism with openMP, each thread adds blocks with the kernel
+  int num_block = static_cast<int>((num_element + kBlock - 1) / kBlock);
+  #pragma omp parallel for schedule(static) num_threads(MV_CONFIG_omp_threads) \
+    if (num_block > 1)
+  for (int i = 0; i < num_block; ++i) {
+    size_t begin = static_cast<size_t>(i) * kBlock;
+    size_t size = std::min<size_t>(kBlock, num_element - begin);
+    kernels::Add(size, data + offset + begin, delta + begin);
+  }
+}
+
+template <typename T>
+void Updater<T>::UpdateRows(const size_t* row_offsets, int count,
+                            size_t num_col, T* data, T* delta,
+                            AddOption* option) {
+  // derived updaters without a batched path go row by row
+  if (typeid(*this) != typeid(Updater<T>)) {
+    for (int i = 0; i < count; ++i) {
+      Update(num_col, data, delta + i * num_col, option, row_offsets[i]);
+    }
+    return;
+  }
+  UpdateRowsWith(kernels::Add, row_offsets, count, num_col, data, delta);
+}
+
+template <typename T>
+void Updater<T>::UpdateRowsWith(void (*kernel)(size_t, T*, const T*),
+                                const size_t* row_offsets, int count,
+                                size_t num_col, T* data, const T* delta) {
+  // Row r goes to thread r % #threads, so a row repeated in the batch is
+  // updated by one thread, in order
+  #pragma omp parallel num_threads(MV_CONFIG_omp_threads) \
+    if (count * num_col > kBlock)
+  {
+    int num_thread = 1, thread = 0;
+#ifdef _OPENMP
+    num_thread = omp_get_num_threads();
+    thread = omp_get_thread_num();
+#endif
+    auto mine = [=](int i) {
+      return static_cast<int>(row_offsets[i] / num_col % num_thread) ==
+        thread;
+    };
+    for (int i = 0; i < count; ++i) {
+      int ahead = i + kPrefetchRows;
+      if (ahead < count && mine(ahead)) {
+        kernels::Prefetch(data + row_offsets[ahead], num_col * sizeof(T));
+        kernels::Prefetch(delta + ahead * num_col, num_col * sizeof(T));
+      }
+      if (!mine(i)) continue;
+      kernel(num_col, data + row_offsets[i], delta + i * num_col);
+    }
   }
 }
 
@@ -38,16 +99,16 @@ void Updater<T>::Access(size_t num_element, T* data, T* blob_data,
 // Gradient-based updater in only for numerical table
 // For simple int table, just using simple updater
 template<>
-Updater<int>* Updater<int>::GetUpdater(size_t) {
+Updater<int>* Updater<int>::GetUpdater(size_t, size_t) {
   return new Updater<int>();
 }
 
 template <typename T>
-Updater<T>* Updater<T>::GetUpdater(size_t size) {
+Updater<T>* Updater<T>::GetUpdater(size_t size, size_t row_size) {
   std::string type = MV_CONFIG_updater_type;
   if (type == "sgd") return new SGDUpdater<T>(size);
-  if (type == "adagrad") return new AdaGradUpdater<T>(size);
-  if (type == "momentum_sgd") return new MomentumUpdater<T>(size);
+  if (type == "adagrad") return new AdaGradUpdater<T>(size, row_size);
+  if (type == "momentum_sgd") return new MomentumUpdater<T>(size, row_size);
 #ifdef ENABLE_DCASGD
   if (type == "dcasgd") return new DCASGDUpdater<T>(size);
   if (type == "dcasgda") return new DCASGDAUpdater<T>(size);
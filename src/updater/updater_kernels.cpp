@@ -0,0 +1,364 @@
+#include "multiverso/updater/updater_kernels.h"
+
+#include <atomic>
+
+#include "multiverso/util/configure.h"
+#include "multiverso/util/log.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MV_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+namespace multiverso {
+
+MV_DEFINE_string(updater_simd, "auto", "instruction set of the updater "
+                 "kernels: auto, avx512, avx2 or scalar");
+
+namespace kernels {
+
+namespace {
+
+// Kernels of one instruction set
+struct Table {
+  const char* isa;
+  void (*add_f)(size_t, float*, const float*);
+  void (*add_d)(size_t, double*, const double*);
+  void (*sub_f)(size_t, float*, const float*);
+  void (*sub_d)(size_t, double*, const double*);
+  void (*momentum_f)(size_t, float*, float*, const float*, float);
+  void (*momentum_d)(size_t, double*, double*, const double*, float);
+  void (*adagrad_f)(size_t, float*, float*, const float*,
+                    float, float, float);
+  void (*adagrad_d)(size_t, double*, double*, const double*,
+                    float, float, float);
+};
+
+const Table kScalar = {
+  "scalar",
+  Add<float>, Add<double>, Sub<float>, Sub<double>,
+  Momentum<float>, Momentum<double>, AdaGrad<float>, AdaGrad<double>
+};
+
+#ifdef MV_KERNELS_X86
+
+// The loops take whole vectors, the scalar kernels finish the tail
+
+#define MV_AVX2 __attribute__((target("avx2,fma")))
+
+MV_AVX2 void AddAvx2(size_t n, float* data, const float* delta) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(data + i, _mm256_add_ps(_mm256_loadu_ps(data + i),
+                                             _mm256_loadu_ps(delta + i)));
+  }
+  Add<float>(n - i, data + i, delta + i);
+}
+
+MV_AVX2 void AddAvx2(size_t n, double* data, const double* delta) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    _mm256_storeu_pd(data + i, _mm256_add_pd(_mm256_loadu_pd(data + i),
+                                             _mm256_loadu_pd(delta + i)));
+  }
+  Add<double>(n - i, data + i, delta + i);
+}
+
+MV_AVX2 void SubAvx2(size_t n, float* data, const float* delta) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(data + i, _mm256_sub_ps(_mm256_loadu_ps(data + i),
+                                             _mm256_loadu_ps(delta + i)));
+  }
+  Sub<float>(n - i, data + i, delta + i);
+}
+
+MV_AVX2 void SubAvx2(size_t n, double* data, const double* delta) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    _mm256_storeu_pd(data + i, _mm256_sub_pd(_mm256_loadu_pd(data + i),
+                                             _mm256_loadu_pd(delta + i)));
+  }
+  Sub<double>(n - i, data + i, delta + i);
+}
+
+MV_AVX2 void MomentumAvx2(size_t n, float* data, float* smooth,
+                          const float* delta, float momentum) {
+  const __m256 m = _mm256_set1_ps(momentum);
+  const __m256 rest = _mm256_set1_ps(1 - momentum);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 s = _mm256_fmadd_ps(m, _mm256_loadu_ps(smooth + i),
+      _mm256_mul_ps(rest, _mm256_loadu_ps(delta + i)));
+    _mm256_storeu_ps(smooth + i, s);
+    _mm256_storeu_ps(data + i, _mm256_sub_ps(_mm256_loadu_ps(data + i), s));
+  }
+  Momentum<float>(n - i, data + i, smooth + i, delta + i, momentum);
+}
+
+MV_AVX2 void MomentumAvx2(size_t n, double* data, double* smooth,
+                          const double* delta, float momentum) {
+  const __m256d m = _mm256_set1_pd(momentum);
+  const __m256d rest = _mm256_set1_pd(1 - momentum);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256d s = _mm256_fmadd_pd(m, _mm256_loadu_pd(smooth + i),
+      _mm256_mul_pd(rest, _mm256_loadu_pd(delta + i)));
+    _mm256_storeu_pd(smooth + i, s);
+    _mm256_storeu_pd(data + i, _mm256_sub_pd(_mm256_loadu_pd(data + i), s));
+  }
+  Momentum<double>(n - i, data + i, smooth + i, delta + i, momentum);
+}
+
+MV_AVX2 void AdaGradAvx2(size_t n, float* data, float* g_sqr,
+                         const float* delta, float lr, float rho, float e) {
+  const __m256 inv_lr_sqr = _mm256_set1_ps(1 / lr / lr);
+  const __m256 rho_lr = _mm256_set1_ps(rho / lr);
+  const __m256 eps = _mm256_set1_ps(e);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 d = _mm256_loadu_ps(delta + i);
+    __m256 g = _mm256_fmadd_ps(_mm256_mul_ps(d, d), inv_lr_sqr,
+                               _mm256_loadu_ps(g_sqr + i));
+    _mm256_storeu_ps(g_sqr + i, g);
+    __m256 step = _mm256_div_ps(_mm256_mul_ps(rho_lr, d),
+                                _mm256_sqrt_ps(_mm256_add_ps(g, eps)));
+    _mm256_storeu_ps(data + i,
+                     _mm256_sub_ps(_mm256_loadu_ps(data + i), step));
+  }
+  AdaGrad<float>(n - i, data + i, g_sqr + i, delta + i, lr, rho, e);
+}
+
+MV_AVX2 void AdaGradAvx2(size_t n, double* data, double* g_sqr,
+                         const double* delta, float lr, float rho, float e) {
+  const __m256d inv_lr_sqr = _mm256_set1_pd(1.0 / lr / lr);
+  const __m256d rho_lr = _mm256_set1_pd(static_cast<double>(rho) / lr);
+  const __m256d eps = _mm256_set1_pd(e);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256d d = _mm256_loadu_pd(delta + i);
+    __m256d g = _mm256_fmadd_pd(_mm256_mul_pd(d, d), inv_lr_sqr,
+                                _mm256_loadu_pd(g_sqr + i));
+    _mm256_storeu_pd(g_sqr + i, g);
+    __m256d step = _mm256_div_pd(_mm256_mul_pd(rho_lr, d),
+                                 _mm256_sqrt_pd(_mm256_add_pd(g, eps)));
+    _mm256_storeu_pd(data + i,
+                     _mm256_sub_pd(_mm256_loadu_pd(data + i), step));
+  }
+  AdaGrad<double>(n - i, data + i, g_sqr + i, delta + i, lr, rho, e);
+}
+
+#define MV_AVX512 __attribute__((target("avx512f")))
+
+MV_AVX512 void AddAvx512(size_t n, float* data, const float* delta) {
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    _mm512_storeu_ps(data + i, _mm512_add_ps(_mm512_loadu_ps(data + i),
+                                             _mm512_loadu_ps(delta + i)));
+  }
+  Add<float>(n - i, data + i, delta + i);
+}
+
+MV_AVX512 void AddAvx512(size_t n, double* data, const double* delta) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm512_storeu_pd(data + i, _mm512_add_pd(_mm512_loadu_pd(data + i),
+                                             _mm512_loadu_pd(delta + i)));
+  }
+  Add<double>(n - i, data + i, delta + i);
+}
+
+MV_AVX512 void SubAvx512(size_t n, float* data, const float* delta) {
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    _mm512_storeu_ps(data + i, _mm512_sub_ps(_mm512_loadu_ps(data + i),
+                                             _mm512_loadu_ps(delta + i)));
+  }
+  Sub<float>(n - i, data + i, delta + i);
+}
+
+MV_AVX512 void SubAvx512(size_t n, double* data, const double* delta) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm512_storeu_pd(data + i, _mm512_sub_pd(_mm512_loadu_pd(data + i),
+                                             _mm512_loadu_pd(delta + i)));
+  }
+  Sub<double>(n - i, data + i, delta + i);
+}
+
+MV_AVX512 void MomentumAvx512(size_t n, float* data, float* smooth,
+                              const float* delta, float momentum) {
+  const __m512 m = _mm512_set1_ps(momentum);
+  const __m512 rest = _mm512_set1_ps(1 - momentum);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m512 s = _mm512_fmadd_ps(m, _mm512_loadu_ps(smooth + i),
+      _mm512_mul_ps(rest, _mm512_loadu_ps(delta + i)));
+    _mm512_storeu_ps(smooth + i, s);
+    _mm512_storeu_ps(data + i, _mm512_sub_ps(_mm512_loadu_ps(data + i), s));
+  }
+  Momentum<float>(n - i, data + i, smooth + i, delta + i, momentum);
+}
+
+MV_AVX512 void MomentumAvx512(size_t n, double* data, double* smooth,
+                              const double* delta, float momentum) {
+  const __m512d m = _mm512_set1_pd(momentum);
+  const __m512d rest = _mm512_set1_pd(1 - momentum);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m512d s = _mm512_fmadd_pd(m, _mm512_loadu_pd(smooth + i),
+      _mm512_mul_pd(rest, _mm512_loadu_pd(delta + i)));
+    _mm512_storeu_pd(smooth + i, s);
+    _mm512_storeu_pd(data + i, _mm512_sub_pd(_mm512_loadu_pd(data + i), s));
+  }
+  Momentum<double>(n - i, data + i, smooth + i, delta + i, momentum);
+}
+
+MV_AVX512 void AdaGradAvx512(size_t n, float* data, float* g_sqr,
+                             const float* delta, float lr, float rho,
+                             float e) {
+  const __m512 inv_lr_sqr = _mm512_set1_ps(1 / lr / lr);
+  const __m512 rho_lr = _mm512_set1_ps(rho / lr);
+  const __m512 eps = _mm512_set1_ps(e);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m512 d = _mm512_loadu_ps(delta + i);
+    __m512 g = _mm512_fmadd_ps(_mm512_mul_ps(d, d), inv_lr_sqr,
+                               _mm512_loadu_ps(g_sqr + i));
+    _mm512_storeu_ps(g_sqr + i, g);
+    // the zero masked sqrt, the plain one reads an undefined source in GCC
+    __m512 step = _mm512_div_ps(_mm512_mul_ps(rho_lr, d),
+      _mm512_maskz_sqrt_ps(0xFFFF, _mm512_add_ps(g, eps)));
+    _mm512_storeu_ps(data + i,
+                     _mm512_sub_ps(_mm512_loadu_ps(data + i), step));
+  }
+  AdaGrad<float>(n - i, data + i, g_sqr + i, delta + i, lr, rho, e);
+}
+
+MV_AVX512 void AdaGradAvx512(size_t n, double* data, double* g_sqr,
+                             const double* delta, float lr, float rho,
+                             float e) {
+  const __m512d inv_lr_sqr = _mm512_set1_pd(1.0 / lr / lr);
+  const __m512d rho_lr = _mm512_set1_pd(static_cast<double>(rho) / lr);
+  const __m512d eps = _mm512_set1_pd(e);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m512d d = _mm512_loadu_pd(delta + i);
+    __m512d g = _mm512_fmadd_pd(_mm512_mul_pd(d, d), inv_lr_sqr,
+                                _mm512_loadu_pd(g_sqr + i));
+    _mm512_storeu_pd(g_sqr + i, g);
+    __m512d step = _mm512_div_pd(_mm512_mul_pd(rho_lr, d),
+      _mm512_maskz_sqrt_pd(0xFF, _mm512_add_pd(g, eps)));
+    _mm512_storeu_pd(data + i,
+                     _mm512_sub_pd(_mm512_loadu_pd(data + i), step));
+  }
+  AdaGrad<double>(n - i, data + i, g_sqr + i, delta + i, lr, rho, e);
+}
+
+// Casts pick the overloads of each type
+const Table kAvx2 = {
+  "avx2",
+  static_cast<void (*)(size_t, float*, const float*)>(AddAvx2),
+  static_cast<void (*)(size_t, double*, const double*)>(AddAvx2),
+  static_cast<void (*)(size_t, float*, const float*)>(SubAvx2),
+  static_cast<void (*)(size_t, double*, const double*)>(SubAvx2),
+  MomentumAvx2, MomentumAvx2, AdaGradAvx2, AdaGradAvx2
+};
+
+const Table kAvx512 = {
+  "avx512",
+  static_cast<void (*)(size_t, float*, const float*)>(AddAvx512),
+  static_cast<void (*)(size_t, double*, const double*)>(AddAvx512),
+  static_cast<void (*)(size_t, float*, const float*)>(SubAvx512),
+  static_cast<void (*)(size_t, double*, const double*)>(SubAvx512),
+  MomentumAvx512, MomentumAvx512, AdaGradAvx512, AdaGradAvx512
+};
+
+#endif  // MV_KERNELS_X86
+
+// Kernels of isa if the CPU runs them, nullptr otherwise
+const Table* Find(const std::string& isa) {
+  if (isa == "scalar") return &kScalar;
+#ifdef MV_KERNELS_X86
+  __builtin_cpu_init();
+  bool avx512 = __builtin_cpu_supports("avx512f") != 0;
+  bool avx2 = __builtin_cpu_supports("avx2") != 0 &&
+              __builtin_cpu_supports("fma") != 0;
+  if (isa == "avx512") return avx512 ? &kAvx512 : nullptr;
+  if (isa == "avx2") return avx2 ? &kAvx2 : nullptr;
+  if (isa == "auto") {
+    return avx512 ? &kAvx512 : (avx2 ? &kAvx2 : &kScalar);
+  }
+#else
+  if (isa == "auto") return &kScalar;
+#endif
+  return nullptr;
+}
+
+std::atomic<const Table*> g_table(nullptr);
+
+const Table* Get() {
+  const Table* table = g_table.load(std::memory_order_acquire);
+  if (table != nullptr) return table;
+  const std::string& isa = MV_CONFIG_updater_simd;
+  table = Find(isa);
+  if (table == nullptr) {
+    Log::Error("updater_simd %s is not supported here, use auto\n",
+               isa.c_str());
+    table = Find("auto");
+  }
+  Log::Debug("Updater kernels use %s\n", table->isa);
+  g_table.store(table, std::memory_order_release);
+  return table;
+}
+
+}  // namespace
+
+std::string Isa() { return Get()->isa; }
+
+bool SetIsa(const std::string& isa) {
+  const Table* table = Find(isa);
+  if (table == nullptr) return false;
+  g_table.store(table, std::memory_order_release);
+  return true;
+}
+
+void Add(size_t n, float* data, const float* delta) {
+  Get()->add_f(n, data, delta);
+}
+
+void Add(size_t n, double* data, const double* delta) {
+  Get()->add_d(n, data, delta);
+}
+
+void Sub(size_t n, float* data, const float* delta) {
+  Get()->sub_f(n, data, delta);
+}
+
+void Sub(size_t n, double* data, const double* delta) {
+  Get()->sub_d(n, data, delta);
+}
+
+void Momentum(size_t n, float* data, float* smooth, const float* delta,
+              float momentum) {
+  Get()->momentum_f(n, data, smooth, delta, momentum);
+}
+
+void Momentum(size_t n, double* data, double* smooth, const double* delta,
+              float momentum) {
+  Get()->momentum_d(n, data, smooth, delta, momentum);
+}
+
+void AdaGrad(size_t n, float* data, float* g_sqr, const float* delta,
+             float lr, float rho, float e) {
+  Get()->adagrad_f(n, data, g_sqr, delta, lr, rho, e);
+}
+
+void AdaGrad(size_t n, double* data, double* g_sqr, const double* delta,
+             float lr, float rho, float e) {
+  Get()->adagrad_d(n, data, g_sqr, delta, lr, rho, e);
+}
+
+}  // namespace kernels
+
+}  // namespace multiverso
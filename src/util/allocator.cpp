@@ -1,6 +1,10 @@
 #include "multiverso/util/allocator.h"
 
+#include <algorithm>
+#include <chrono>
 #include <mutex>
+#include <sstream>
+#include <vector>
 
 #include "multiverso/util/log.h"
 #include "multiverso/util/configure.h"
@@ -8,6 +12,10 @@
 namespace multiverso {
 
 MV_DEFINE_int(allocator_alignment, 16, "alignment for align malloc");
+MV_DEFINE_int(allocator_cache_mb, 0, "max MB of free blocks kept for reuse, "
+              "0 for no limit");
+MV_DEFINE_int(allocator_trim_sec, 60, "free blocks not reused for this many "
+              "seconds, 0 to keep them");
 
 inline char* AlignMalloc(size_t size) {
 #ifdef _MSC_VER 
@@ -29,9 +37,173 @@ inline void AlignFree(char *data) {
 #endif
 }
 
-inline FreeList::FreeList(size_t size) : size_(size) {
+namespace {
+
+// bytes of a size class a thread keeps, larger blocks are not cached
+const size_t kThreadCacheBytes = 1 << 18;
+
+// set once the cache of the thread is gone, blocks freed by static
+// destructors go straight to the lists
+thread_local bool thread_cache_destroyed = false;
+
+int SizeClass(size_t size) {
+  int size_class = SmartAllocator::kMinSizeClass;
+  while ((static_cast<size_t>(1) << size_class) < size) ++size_class;
+  return size_class;
+}
+
+// Only written by the owner thread, read by the monitor
+template <typename T>
+void Add(std::atomic<T>* counter, T delta) {
+  counter->store(counter->load(std::memory_order_relaxed) + delta,
+                 std::memory_order_relaxed);
+}
+
+long long NowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}  // namespace
+
+// Free blocks kept by a thread for each size class, so that most Alloc and
+// Free calls take no lock
+class ThreadCache {
+public:
+  ThreadCache() {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.caches.push_back(this);
+  }
+
+  ~ThreadCache() {
+    DrainAll();
+    Registry& registry = GetRegistry();
+    {
+      std::lock_guard<std::mutex> lock(registry.mutex);
+      for (int i = 0; i < SmartAllocator::kNumSizeClasses; ++i) {
+        registry.retired_live[i] += bins_[i].live.load();
+      }
+      registry.caches.erase(std::find(registry.caches.begin(),
+                                      registry.caches.end(), this));
+    }
+    thread_cache_destroyed = true;
+  }
+
+  static ThreadCache* Get() {
+    if (thread_cache_destroyed) return nullptr;
+    thread_local ThreadCache cache;
+    return &cache;
+  }
+
+  MemoryBlock* Pop(FreeList* list) {
+    Bin& bin = Select(list);
+    if (bin.count == 0) {
+      bin.head = nullptr;
+      Add(&bin.count, list->PopBatch(std::max(Limit(list) / 2, 1),
+                                     &bin.head));
+    }
+    MemoryBlock* block = bin.head;
+    bin.head = block->next;
+    Add(&bin.count, -1);
+    Add(&bin.live, static_cast<long long>(list->size()));
+    return block;
+  }
+
+  void Push(FreeList* list, MemoryBlock* block) {
+    Bin& bin = Select(list);
+    block->next = bin.head;
+    bin.head = block;
+    Add(&bin.live, -static_cast<long long>(list->size()));
+    Add(&bin.count, 1);
+    int limit = Limit(list);
+    if (bin.count > limit) Drain(&bin, bin.count - limit / 2);
+  }
+
+  void DrainAll() {
+    for (auto& bin : bins_) {
+      if (bin.count > 0) Drain(&bin, bin.count);
+    }
+  }
+
+  // Bytes of a size class in use and kept by all threads
+  static void GetBytes(int size_class, size_t size, long long* live,
+                       long long* cached) {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    *live = registry.retired_live[size_class];
+    *cached = 0;
+    for (ThreadCache* cache : registry.caches) {
+      *live += cache->bins_[size_class].live.load(std::memory_order_relaxed);
+      *cached += cache->bins_[size_class].count.load(
+        std::memory_order_relaxed) * static_cast<long long>(size);
+    }
+  }
+
+  // Blocks freed without a thread cache
+  static void AddRetired(int size_class, long long live) {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.retired_live[size_class] += live;
+  }
+
+private:
+  struct Bin {
+    MemoryBlock* head = nullptr;
+    std::atomic<int> count{ 0 };
+    FreeList* list = nullptr;
+    // bytes allocated minus bytes freed by this thread
+    std::atomic<long long> live{ 0 };
+  };
+
+  struct Registry {
+    std::mutex mutex;
+    std::vector<ThreadCache*> caches;
+    // live bytes of the threads gone
+    long long retired_live[SmartAllocator::kNumSizeClasses] = { 0 };
+  };
+
+  // never destroyed, threads may exit after static destructors
+  static Registry& GetRegistry() {
+    static Registry* registry = new Registry();
+    return *registry;
+  }
+
+  // Bin of the size class of list, there is one list per size class as long
+  // as there is one SmartAllocator
+  Bin& Select(FreeList* list) {
+    Bin& bin = bins_[list->size_class()];
+    if (bin.list != list) {
+      if (bin.count > 0) Drain(&bin, bin.count);
+      bin.list = list;
+    }
+    return bin;
+  }
+
+  static int Limit(FreeList* list) {
+    return static_cast<int>(kThreadCacheBytes / list->size());
+  }
+
+  // Give n blocks of bin back to its list
+  void Drain(Bin* bin, int n) {
+    MemoryBlock* head = bin->head;
+    MemoryBlock* tail = head;
+    for (int i = 1; i < n; ++i) tail = tail->next;
+    bin->head = tail->next;
+    Add(&bin->count, -n);
+    bin->list->PushBatch(head, tail, n);
+  }
+
+  Bin bins_[SmartAllocator::kNumSizeClasses];
+};
+
+inline FreeList::FreeList(size_t size, int size_class,
+                          SmartAllocator* owner) :
+  size_(size), size_class_(size_class), owner_(owner), free_count_(1),
+  min_free_count_(1), total_count_(1), peak_count_(1) {
   mutex_ = new std::mutex();
   free_ = new MemoryBlock(size, this);
+  owner_->cached_bytes_ += size_;
 }
 
 FreeList::~FreeList() {
@@ -45,19 +217,111 @@ FreeList::~FreeList() {
 }
 
 inline char* FreeList::Pop() {
+  ThreadCache* cache = ThreadCache::Get();
+  if (cache != nullptr) return cache->Pop(this)->data();
+  MemoryBlock* block;
+  PopBatch(1, &block);
+  ThreadCache::AddRetired(size_class_, static_cast<long long>(size_));
+  return block->data();
+}
+
+inline void FreeList::Push(MemoryBlock*block) {
+  ThreadCache* cache = ThreadCache::Get();
+  if (cache != nullptr) {
+    cache->Push(this, block);
+  } else {
+    ThreadCache::AddRetired(size_class_, -static_cast<long long>(size_));
+    PushBatch(block, block, 1);
+  }
+}
+
+int FreeList::PopBatch(int n, MemoryBlock** head) {
+  int count = 1;
+  {
+    std::lock_guard<std::mutex> lock(*mutex_);
+    if (free_ == nullptr) {
+      *head = new MemoryBlock(size_, this);
+      peak_count_ = std::max(peak_count_, ++total_count_);
+    } else {
+      MemoryBlock* tail = free_;
+      for (; count < n && tail->next != nullptr; ++count) tail = tail->next;
+      *head = free_;
+      free_ = tail->next;
+      tail->next = nullptr;
+      free_count_ -= count;
+      min_free_count_ = std::min(min_free_count_, free_count_);
+      owner_->cached_bytes_ -= count * static_cast<long long>(size_);
+    }
+  }
+  owner_->TrimIfDue();
+  return count;
+}
+
+void FreeList::PushBatch(MemoryBlock* head, MemoryBlock* tail, int n) {
+  long long bytes = n * static_cast<long long>(size_);
+  long long cap = MV_CONFIG_allocator_cache_mb * (1ll << 20);
+  {
+    std::lock_guard<std::mutex> lock(*mutex_);
+    if (cap > 0 && owner_->cached_bytes_ + bytes > cap) {
+      // over the cap, back to the system
+      tail->next = nullptr;
+      while (head != nullptr) {
+        MemoryBlock* next = head->next;
+        delete head;
+        head = next;
+      }
+      total_count_ -= n;
+    } else {
+      tail->next = free_;
+      free_ = head;
+      free_count_ += n;
+      owner_->cached_bytes_ += bytes;
+    }
+  }
+  owner_->TrimIfDue();
+}
+
+void FreeList::TrimIdle() {
   std::lock_guard<std::mutex> lock(*mutex_);
-  if (free_ == nullptr) {
-    free_ = new MemoryBlock(size_, this);
+  FreeBlocks(min_free_count_);
+  min_free_count_ = free_count_;
+}
+
+void FreeList::Trim() {
+  std::lock_guard<std::mutex> lock(*mutex_);
+  FreeBlocks(free_count_);
+  min_free_count_ = 0;
+}
+
+void FreeList::FreeBlocks(int n) {
+  if (n <= 0) return;
+  MemoryBlock* rest;
+  if (n == free_count_) {
+    rest = free_;
+    free_ = nullptr;
+  } else {
+    MemoryBlock* last = free_;
+    for (int i = 1; i < free_count_ - n; ++i) last = last->next;
+    rest = last->next;
+    last->next = nullptr;
+  }
+  while (rest != nullptr) {
+    MemoryBlock* next = rest->next;
+    delete rest;
+    rest = next;
   }
-  char* data = free_->data();
-  free_ = free_->next;
-  return data;
+  free_count_ -= n;
+  total_count_ -= n;
+  owner_->cached_bytes_ -= n * static_cast<long long>(size_);
 }
 
-inline void FreeList::Push(MemoryBlock*block) {
+void FreeList::GetBytes(long long* free, long long* total,
+                        long long* peak) const {
   std::lock_guard<std::mutex> lock(*mutex_);
-  block->next = free_;
-  free_ = block;
+  long long size = static_cast<long long>(size_);
+  *free = free_count_ * size;
+  *total = total_count_ * size;
+  *peak = peak_count_ * size;
 }
 
 inline MemoryBlock::MemoryBlock(size_t size, FreeList* list) :
@@ -87,28 +351,21 @@ inline void MemoryBlock::Link() {
 }
 
 char* SmartAllocator::Alloc(size_t size) {
-  if (size <= 32) {
-    size = 32;
-  }
-  else { // 2^n
-    size -= 1;
-    size |= size >> 32;
-    size |= size >> 16;
-    size |= size >> 8;
-    size |= size >> 4;
-    size |= size >> 2;
-    size |= size >> 1;
-    size += 1;
-  }
+  return GetFreeList(SizeClass(size))->Pop();
+}
 
-  {
+FreeList* SmartAllocator::GetFreeList(int size_class) {
+  FreeList* list = pools_[size_class].load(std::memory_order_acquire);
+  if (list == nullptr) {
     std::lock_guard<std::mutex> lock(*mutex_);
-    if (pools_[size] == nullptr) {
-      pools_[size] = new FreeList(size);
+    list = pools_[size_class].load(std::memory_order_relaxed);
+    if (list == nullptr) {
+      list = new FreeList(static_cast<size_t>(1) << size_class, size_class,
+                          this);
+      pools_[size_class].store(list, std::memory_order_release);
     }
   }
-
-  return pools_[size]->Pop();
+  return list;
 }
 
 void SmartAllocator::Free(char *data) {
@@ -119,16 +376,86 @@ void SmartAllocator::Refer(char *data) {
   (*(MemoryBlock**)(data - g_pointer_size))->Link();
 }
 
-SmartAllocator::SmartAllocator() {
+void SmartAllocator::Trim() {
+  ThreadCache* cache = ThreadCache::Get();
+  if (cache != nullptr) cache->DrainAll();
+  for (auto& pool : pools_) {
+    FreeList* list = pool.load(std::memory_order_acquire);
+    if (list != nullptr) list->Trim();
+  }
+}
+
+void SmartAllocator::TrimIfDue() {
+  if (MV_CONFIG_allocator_trim_sec <= 0) return;
+  long long now = NowMs();
+  long long due = next_trim_ms_.load(std::memory_order_relaxed);
+  if (now < due) return;
+  // one thread trims
+  if (!next_trim_ms_.compare_exchange_strong(due,
+        now + MV_CONFIG_allocator_trim_sec * 1000ll)) {
+    return;
+  }
+  if (due == 0) return;  // the first call only sets the clock
+  for (auto& pool : pools_) {
+    FreeList* list = pool.load(std::memory_order_acquire);
+    if (list != nullptr) list->TrimIdle();
+  }
+}
+
+void SmartAllocator::GetStats(int size_class, Stats* stats) const {
+  FreeList* list = pools_[size_class].load(std::memory_order_acquire);
+  if (list == nullptr) {
+    stats->live = stats->cached = stats->total = stats->peak = 0;
+    return;
+  }
+  long long free;
+  list->GetBytes(&free, &stats->total, &stats->peak);
+  ThreadCache::GetBytes(size_class, list->size(), &stats->live,
+                        &stats->cached);
+  stats->cached += free;
+}
+
+SmartAllocator::SmartAllocator() : cached_bytes_(0), next_trim_ms_(0) {
   mutex_ = new std::mutex();
+  for (auto& pool : pools_) pool.store(nullptr);
+  monitor_ = new AllocatorMonitor(this);
 }
 
 SmartAllocator::~SmartAllocator() {
-  Log::Debug("~SmartAllocator, final pool size: %d\n", pools_.size());
+  delete monitor_;
   delete mutex_;
-  for (auto i : pools_) {
-    delete i.second;
+  for (auto& pool : pools_) {
+    delete pool.load();
+  }
+}
+
+AllocatorMonitor::AllocatorMonitor(SmartAllocator* allocator) :
+  Monitor("ALLOCATOR"), allocator_(allocator) {}
+
+AllocatorMonitor::~AllocatorMonitor() {
+  Dashboard::RemoveMonitor(name());
+}
+
+std::string AllocatorMonitor::info_string() const {
+  std::ostringstream oss;
+  SmartAllocator::Stats sum = { 0, 0, 0, 0 };
+  std::ostringstream classes;
+  for (int i = 0; i < SmartAllocator::kNumSizeClasses; ++i) {
+    SmartAllocator::Stats stats;
+    allocator_->GetStats(i, &stats);
+    if (stats.peak == 0) continue;
+    classes << "\n  2^" << i << " bytes: live = " << stats.live
+            << " cached = " << stats.cached << " total = " << stats.total
+            << " peak = " << stats.peak;
+    sum.live += stats.live;
+    sum.cached += stats.cached;
+    sum.total += stats.total;
   }
+  oss << "[" << name() << "] "
+      << " live = " << sum.live
+      << " cached = " << sum.cached
+      << " total = " << sum.total << " bytes" << classes.str();
+  return oss.str();
 }
 
 char* Allocator::Alloc(size_t size) {
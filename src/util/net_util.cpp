@@ -1,5 +1,6 @@
 #include "multiverso/util/net_util.h"
 
+#include <cstdio>
 #include <string>
 #include "multiverso/util/log.h"
 
@@ -97,5 +98,26 @@ void GetLocalIPAddress(std::unordered_set<std::string>* result) {
 
 #endif  // _MSC_VER
 
+void ParseMachineFile(const std::string& filename,
+                      std::vector<std::string>* result) {
+  CHECK_NOTNULL(result);
+  FILE* file;
+  char str[64];
+#ifdef _MSC_VER
+  fopen_s(&file, filename.c_str(), "r");
+#else
+  file = fopen(filename.c_str(), "r");
+#endif
+  CHECK_NOTNULL(file);
+#ifdef _MSC_VER
+  while (fscanf_s(file, "%63s", &str, 64) > 0) {
+#else
+  while (fscanf(file, "%63s", str) > 0) {
+#endif
+    result->push_back(str);
+  }
+  fclose(file);
+}
+
 }  // namespace net
 }  // namespace multiverso
@@ -0,0 +1,123 @@
+#include "multiverso/util/storage_allocator.h"
+
+#include <cstdint>
+#include <cstdlib>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "multiverso/util/configure.h"
+#include "multiverso/util/log.h"
+
+namespace multiverso {
+
+MV_DEFINE_string(server_storage, "default", "memory of server tables: "
+                 "default, or hugepage to back large tables by huge pages");
+MV_DEFINE_int(server_numa_node, -1, "NUMA node the memory of server tables "
+              "is bound to, -1 to place it where it is first used");
+
+namespace storage {
+
+namespace {
+
+const size_t kHugePageSize = 2 << 20;
+const int kBindPolicy = 2;  // MPOL_BIND of linux/mempolicy.h
+
+size_t RoundUp(size_t bytes, size_t page) {
+  return (bytes + page - 1) / page * page;
+}
+
+#ifndef _WIN32
+// Bytes mapped for a large block, whole huge or normal pages
+size_t MappedSize(size_t bytes, bool huge_pages) {
+  return RoundUp(bytes, huge_pages ? kHugePageSize :
+                 static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+}
+
+// Map size bytes at a huge page boundary, so that all of them can be huge
+void* MapAligned(size_t size) {
+  size_t mapped = size + kHugePageSize;
+  char* data = static_cast<char*>(mmap(nullptr, mapped,
+    PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+  if (data == MAP_FAILED) return nullptr;
+  uintptr_t address = reinterpret_cast<uintptr_t>(data);
+  size_t head = (kHugePageSize - address % kHugePageSize) % kHugePageSize;
+  if (head > 0) munmap(data, head);
+  if (kHugePageSize - head > 0) {
+    munmap(data + head + size, kHugePageSize - head);
+  }
+  return data + head;
+}
+
+void Bind(void* data, size_t size) {
+  int node = MV_CONFIG_server_numa_node;
+  if (node < 0) return;
+#ifdef SYS_mbind
+  CHECK(node < 64);
+  unsigned long mask = 1ul << node;
+  if (syscall(SYS_mbind, data, size, kBindPolicy, &mask,
+              sizeof(mask) * 8, 0) != 0) {
+    Log::Error("Failed to bind server storage to NUMA node %d\n", node);
+  }
+#endif
+}
+#endif
+
+}  // namespace
+
+bool UseHugePages() {
+  return MV_CONFIG_server_storage == "hugepage";
+}
+
+void* Allocate(size_t bytes, bool huge_pages) {
+#ifndef _WIN32
+  // large blocks are mapped rather than taken from calloc: fresh mappings are
+  // zeroed and untouched, and start at a page boundary as mbind needs
+  if (bytes >= kHugePageSize) {
+    size_t size = MappedSize(bytes, huge_pages);
+    void* data = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (huge_pages) {
+      data = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+#endif
+    if (data == MAP_FAILED) {
+      // no huge pages reserved, ask for transparent ones
+      data = huge_pages ? MapAligned(size) :
+        mmap(nullptr, size, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (data == nullptr || data == MAP_FAILED) {
+        Log::Fatal("Failed to map %lld bytes\n",
+                   static_cast<long long>(size));
+      }
+#ifdef MADV_HUGEPAGE
+      if (huge_pages) madvise(data, size, MADV_HUGEPAGE);
+#endif
+    }
+    Bind(data, size);
+    return data;
+  }
+#endif
+  void* data = calloc(bytes > 0 ? bytes : 1, 1);
+  if (data == nullptr) Log::Fatal("Failed to allocate %lld bytes\n",
+                                  static_cast<long long>(bytes));
+  return data;
+}
+
+void Free(void* data, size_t bytes, bool huge_pages) {
+#ifndef _WIN32
+  if (bytes >= kHugePageSize) {
+    munmap(data, MappedSize(bytes, huge_pages));
+    return;
+  }
+#endif
+  free(data);
+}
+
+}  // namespace storage
+
+}  // namespace multiverso
@@ -38,7 +38,7 @@ void Worker::ProcessGet(MessagePtr& msg) {
   cache_[table_id]->Reset(msg_id, num);
 
   for (auto& it : partitioned_key) {
-    MessagePtr new_msg(new Message());
+    MessagePtr new_msg(Message::Create());
     new_msg->set_src(Zoo::Get()->rank());
     new_msg->set_dst(it.first);
     new_msg->set_type(MsgType::Request_Get);
@@ -63,7 +63,7 @@ void Worker::ProcessAdd(MessagePtr& msg) {
   cache_[table_id]->Reset(msg_id, num);
 
   for (auto& it : partitioned_kv) {
-    MessagePtr kv_msg(new Message());
+    MessagePtr kv_msg(Message::Create());
 	kv_msg->set_src(Zoo::Get()->rank());
 	kv_msg->set_dst(it.first);
 	kv_msg->set_type(MsgType::Request_Add);
@@ -78,7 +78,7 @@ void Worker::ProcessAdd(MessagePtr& msg) {
 void Worker::ProcessReplyGet(MessagePtr& msg) {
   MONITOR_BEGIN(WORKER_PROCESS_REPLY_GET)
   int table_id = msg->table_id();
-  cache_[table_id]->ProcessReplyGet(msg->data());
+  cache_[table_id]->ProcessReplyGet(msg->data(), msg->msg_id());
   cache_[table_id]->Notify(msg->msg_id());
   MONITOR_END(WORKER_PROCESS_REPLY_GET)
 }
@@ -114,7 +114,7 @@ void Zoo::StopPS() {
 }
 
 void Zoo::RegisterNode() {
-  MessagePtr msg(new Message());
+  MessagePtr msg(Message::Create());
   msg->set_src(rank());
   msg->set_dst(kController);
   msg->set_type(MsgType::Control_Register);
@@ -152,7 +152,7 @@ void Zoo::RegisterActor(const std::string name, Actor* actor) {
 void Zoo::FinishTrain() {
   for (auto i = 0; i < num_servers_; i++) {
     int dst_rank = server_id_to_rank(i);
-    MessagePtr msg(new Message());
+    MessagePtr msg(Message::Create());
     msg->set_src(rank());
     msg->set_dst(dst_rank);
     msg->set_type(MsgType::Server_Finish_Train);
@@ -162,7 +162,7 @@ void Zoo::FinishTrain() {
 
 
 void Zoo::Barrier() {
-  MessagePtr msg(new Message());
+  MessagePtr msg(Message::Create());
   msg->set_src(rank());
   msg->set_dst(kController); 
   msg->set_type(MsgType::Control_Barrier);